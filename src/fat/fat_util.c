@@ -13,6 +13,7 @@
 #include <unistd.h>
 
 #include "../lib/macros.h"
+#include "../lib/tagged_alloc.h"
 
 file_system fs;
 
@@ -176,6 +177,82 @@ int next_free_block() {
     exit(EXIT_FAILURE);
 }
 
+uint16_t get_last_block(directory_entry *de) {
+    if (de->size == 0 || de->firstBlock == EOF_IDX) {
+        return EOF_IDX;
+    }
+
+    if (de->lastBlock == 0 || de->lastBlock == EOF_IDX) {
+        int block = de->firstBlock;
+
+        for (int i = 0; i < (de->size - 1) / fs.block_size; i++) {
+            block = fs.fat_region[block];
+        }
+
+        de->lastBlock = block;
+    }
+
+    return de->lastBlock;
+}
+
+void free_file_blocks(directory_entry *de) {
+    int next_block = de->firstBlock;
+
+    while (next_block != EOF_IDX) {
+        int temp_block = fs.fat_region[next_block];
+        fs.fat_region[next_block] = 0;
+        next_block = temp_block;
+    }
+
+    de->firstBlock = EOF_IDX;
+    de->lastBlock = EOF_IDX;
+    de->size = 0;
+}
+
+// Frees every block after block in its chain and makes block the end of the chain.
+static void free_blocks_after(uint16_t block) {
+    int next_block = fs.fat_region[block];
+    fs.fat_region[block] = EOF_IDX;
+
+    while (next_block != EOF_IDX) {
+        int temp_block = fs.fat_region[next_block];
+        fs.fat_region[next_block] = 0;
+        next_block = temp_block;
+    }
+}
+
+// Returns the block after block in its chain, allocating and linking a new one if block is the last.
+static uint16_t next_or_new_block(uint16_t block) {
+    if (fs.fat_region[block] == EOF_IDX) {
+        int new_block = next_free_block();
+        fs.fat_region[new_block] = EOF_IDX;
+        fs.fat_region[block] = new_block;
+    }
+
+    return fs.fat_region[block];
+}
+
+void truncate_file_blocks(directory_entry *de, int len) {
+    if (len >= de->size) {
+        return;
+    }
+
+    if (len == 0) {
+        free_file_blocks(de);
+        return;
+    }
+
+    int block = de->firstBlock;
+
+    for (int i = 0; i < (len - 1) / fs.block_size; i++) {
+        block = fs.fat_region[block];
+    }
+
+    free_blocks_after(block);
+    de->lastBlock = block;
+    de->size = len;
+}
+
 void read_directory_entries() {
     HANDLE_SYS_CALL(lseek(fs.fd, get_offset_for_block_num(1), SEEK_SET) < 0, "Error lseeking to read directory.");
     clear(&fs.dir, free_directory_entry);
@@ -192,7 +269,7 @@ void read_directory_entries() {
 
             // Empty entry.
             if (d->name[0] <= DELETED_BUT_IN_USE) {
-                free(d);
+                tagged_free(d);
             } else {
                 push_back(&fs.dir, d);
             }
@@ -277,7 +354,7 @@ bool mount(char *fs_name) {
     fs.fd = open(fs_name, O_RDWR, FILE_OPEN_MODE);
     HANDLE_INVALID_INPUT(fs.fd < 0, "Error opening fs to mount. File probably doesn't exist.\n");
 
-    fs.fs_name = (char *) malloc(strlen(fs_name) * sizeof(char) + 1);
+    fs.fs_name = (char *) tagged_malloc(MEM_FILE_SYSTEM, strlen(fs_name) * sizeof(char) + 1);
     if (fs.fs_name == NULL) {
         perror("Error mallocing fs_name in mount");
         exit(EXIT_FAILURE);
@@ -308,6 +385,7 @@ bool mount(char *fs_name) {
         exit(EXIT_FAILURE);
     }
 
+    account_mapping(MEM_FILE_SYSTEM, fs.fat_size);
     read_directory_entries();
     fs.is_mounted = true;
 
@@ -324,7 +402,7 @@ void umount() {
 
     fs.is_mounted = false;
 
-    free(fs.fs_name);
+    tagged_free(fs.fs_name);
     fs.fs_name = NULL;
 
     if (munmap(fs.fat_region, fs.fat_size) != 0) {
@@ -332,6 +410,8 @@ void umount() {
         exit(EXIT_FAILURE);
     }
 
+    account_mapping(MEM_FILE_SYSTEM, -(long long) fs.fat_size);
+
     HANDLE_SYS_CALL(close(fs.fd) < 0, "Error closing fs to unmount");
     fs.fd = -1;
 
@@ -362,33 +442,52 @@ directory_entry *touch(char *file) {
     return d;
 }
 
-void ls() {
-    // The columns above are first block number, permissions, size, month, day, time, and name.
-    char months[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+int read_dir_batch(linked_list_elem **cursor, file_stat *stats, int max) {
+    int n = 0;
 
-    for (linked_list_elem *l = fs.dir.head; l != NULL; l = l->next) {
-        directory_entry *de = l->val;
+    while (*cursor != NULL && n < max) {
+        directory_entry *de = (*cursor)->val;
 
-        if (de->name[0] < FILE_EXISTS) {
-            continue;
+        if (de != NULL && de->name[0] >= FILE_EXISTS) {
+            stat_directory_entry(de, &stats[n++]);
         }
 
-        int block_num = de->firstBlock;
-        char x = de->perm & EXEC_ONLY ? 'x' : '-';
-        char r = de->perm & READ_ONLY ? 'r' : '-';
-        char w = de->perm & WRITE_ONLY ? 'w' : '-';
-        int size = de->size;
-        char *name = de->name;
+        *cursor = (*cursor)->next;
+    }
+
+    return n;
+}
+
+int format_ls_page(char *page, file_stat *stats, int n) {
+    // The columns are first block number, permissions, size, month, day, time, and name.
+    char months[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    int len = 0;
+
+    for (int i = 0; i < n; i++) {
+        file_stat *st = &stats[i];
 
-        struct tm t = *localtime(&de->mtime);
+        char x = st->perm & EXEC_ONLY ? 'x' : '-';
+        char r = st->perm & READ_ONLY ? 'r' : '-';
+        char w = st->perm & WRITE_ONLY ? 'w' : '-';
 
-        char *month = months[t.tm_mon];
-        int day = t.tm_mday;
-        int hour = t.tm_hour;
-        int minute = t.tm_min;
+        struct tm t;
+        localtime_r(&st->mtime, &t);
+
+        len += snprintf(page + len, LS_LINE_LENGTH, "%5d %c%c%c %5d %s %-2d %02d:%02d %s\n", st->firstBlock, x, r, w,
+                        st->size, months[t.tm_mon], t.tm_mday, t.tm_hour, t.tm_min, st->name);
+    }
+
+    return len;
+}
+
+void ls() {
+    linked_list_elem *cursor = fs.dir.head;
+    file_stat stats[LS_PAGE_ENTRIES];
+    char page[LS_PAGE_ENTRIES * LS_LINE_LENGTH];
+    int n;
 
-        fprintf(stderr, "%5d %c%c%c %5d %s %-2d %02d:%02d %s\n", block_num, x, r, w, size, month, day, hour, minute,
-                name);
+    while ((n = read_dir_batch(&cursor, stats, LS_PAGE_ENTRIES)) > 0) {
+        HANDLE_SYS_CALL(write(STDERR_FILENO, page, format_ls_page(page, stats, n)) < 0, "Error writing ls output.");
     }
 }
 
@@ -418,17 +517,7 @@ void rm(char *file) {
     HANDLE_INVALID_INPUT_VOID_FMT(de->name[0] < FILE_EXISTS, "rm: File %s has already been deleted.\n", file);
 
     de->name[0] = (char) DELETED;
-    de->size = 0;
-
-    int next_block = de->firstBlock;
-
-    while (next_block != EOF_IDX) {
-        int temp_block = fs.fat_region[next_block];
-        fs.fat_region[next_block] = 0;
-        next_block = temp_block;
-    }
-
-    de->firstBlock = EOF_IDX;
+    free_file_blocks(de);
     write_dell();
 }
 
@@ -500,16 +589,7 @@ void cat(char **c, int num_args) {
 
         // If overwrite, then just clear the file, and then append.
         if (overwrite) {
-            int block = de->firstBlock;
-
-            while (block != EOF_IDX) {
-                int next_block = fs.fat_region[block];
-                fs.fat_region[block] = 0;
-                block = next_block;
-            }
-
-            de->firstBlock = EOF_IDX;
-            de->size = 0;
+            free_file_blocks(de);
         }
 
         int bytes_read;
@@ -517,14 +597,7 @@ void cat(char **c, int num_args) {
         bool first_write = de->size == 0;
 
         // Find last block used in file.
-        int dst_block = de->firstBlock;
-        while (dst_block != EOF_IDX) {
-            if (fs.fat_region[dst_block] == EOF_IDX) {
-                break;
-            }
-
-            dst_block = fs.fat_region[dst_block];
-        }
+        int dst_block = get_last_block(de);
 
         while (true) {
             uint8_t buf[MAX_LINE_LENGTH] = {'\0'};
@@ -565,6 +638,7 @@ void cat(char **c, int num_args) {
 
                 buf_offset += bytes_to_write_in_block;
                 de->size += bytes_to_write_in_block;
+                de->lastBlock = dst_block;
                 bytes_read -= bytes_to_write_in_block;
             }
         }
@@ -581,27 +655,11 @@ void cat(char **c, int num_args) {
 
         // If overwrite, then just clear the file, and then append.
         if (overwrite) {
-            int block = de->firstBlock;
-
-            while (block != EOF_IDX) {
-                int next_block = fs.fat_region[block];
-                fs.fat_region[block] = 0;
-                block = next_block;
-            }
-
-            de->firstBlock = EOF_IDX;
-            de->size = 0;
+            free_file_blocks(de);
         }
 
         // Find last block used in file.
-        int dst_block = de->firstBlock;
-        while (dst_block != EOF_IDX) {
-            if (fs.fat_region[dst_block] == EOF_IDX) {
-                break;
-            }
-
-            dst_block = fs.fat_region[dst_block];
-        }
+        int dst_block = get_last_block(de);
 
         bool first_write = de->size == 0;
 
@@ -656,6 +714,7 @@ void cat(char **c, int num_args) {
 
                     buf_offset += bytes_to_write_in_block;
                     de->size += bytes_to_write_in_block;
+                    de->lastBlock = dst_block;
                     bytes_read -= bytes_to_write_in_block;
                 }
 
@@ -705,27 +764,20 @@ void cpFATtoFAT(char *src, char *dst) {
     directory_entry *dst_de = dst_elem->val;
     HANDLE_INVALID_INPUT_VOID_FMT((dst_de->perm & WRITE_ONLY) == 0, "cp: %s: Permission denied\n", dst);
 
-    dst_de->size = src_de->size;
     dst_de->mtime = time(NULL);
 
-    // Remove all dst blocks.
-    int dst_block = dst_de->firstBlock;
-    while (dst_block != EOF_IDX) {
-        int next = fs.fat_region[dst_block];
-        fs.fat_region[dst_block] = 0;
-        dst_block = next;
-    }
-
-    // If empty file, set firstBlock = 0xFFFF and return.
-    if (dst_de->size == 0) {
-        dst_de->firstBlock = EOF_IDX;
+    // If empty file, just free all dst blocks.
+    if (src_de->size == 0) {
+        free_file_blocks(dst_de);
         write_dell();
         return;
     }
 
-    // Allocate first block for dst.
-    dst_de->firstBlock = next_free_block();
-    fs.fat_region[dst_de->firstBlock] = EOF_IDX;
+    // Overwrite dst in place, so its blocks are reused and new ones are only allocated once they run out.
+    if (dst_de->firstBlock == EOF_IDX) {
+        dst_de->firstBlock = next_free_block();
+        fs.fat_region[dst_de->firstBlock] = EOF_IDX;
+    }
 
     int current_src_block = src_de->firstBlock;
     int current_dst_block = dst_de->firstBlock;
@@ -749,12 +801,14 @@ void cpFATtoFAT(char *src, char *dst) {
         current_src_block = fs.fat_region[current_src_block];
 
         if (bytes_left > 0) {
-            fs.fat_region[current_dst_block] = next_free_block();
-            current_dst_block = fs.fat_region[current_dst_block];
-            fs.fat_region[current_dst_block] = EOF_IDX;
+            current_dst_block = next_or_new_block(current_dst_block);
         }
     }
 
+    // Free whatever is left of the old dst.
+    free_blocks_after(current_dst_block);
+    dst_de->size = src_de->size;
+    dst_de->lastBlock = current_dst_block;
     write_dell();
 }
 
@@ -772,23 +826,17 @@ void cpHosttoFAT(char *src, char *dst) {
     directory_entry *dst_de = dst_elem->val;
     HANDLE_INVALID_INPUT_VOID_FMT((dst_de->perm & WRITE_ONLY) == 0, "cp: %s: Permission denied\n", dst);
 
-    dst_de->size = 0;
     dst_de->mtime = time(NULL);
 
-    // Remove all dst blocks.
-    int dst_block = dst_de->firstBlock;
-    while (dst_block != EOF_IDX) {
-        int next = fs.fat_region[dst_block];
-        fs.fat_region[dst_block] = 0;
-        dst_block = next;
+    // Overwrite dst in place, so its blocks are reused and new ones are only allocated once they run out.
+    if (dst_de->firstBlock == EOF_IDX) {
+        dst_de->firstBlock = next_free_block();
+        fs.fat_region[dst_de->firstBlock] = EOF_IDX;
     }
 
-    // Allocate first block for dst.
-    dst_de->firstBlock = next_free_block();
-    fs.fat_region[dst_de->firstBlock] = EOF_IDX;
-
     int current_dst_block = dst_de->firstBlock;
     bool first_block = true;
+    dst_de->size = 0;
 
     uint8_t src_block_data[fs.block_size];
 
@@ -803,11 +851,9 @@ void cpHosttoFAT(char *src, char *dst) {
         }
 
         // Write to destination.
-        // Allocate block to write to, if it's not the first block.
+        // Move on to the next block to write to, if it's not the first block.
         if (!first_block) {
-            fs.fat_region[current_dst_block] = next_free_block();
-            current_dst_block = fs.fat_region[current_dst_block];
-            fs.fat_region[current_dst_block] = EOF_IDX;
+            current_dst_block = next_or_new_block(current_dst_block);
         }
 
         HANDLE_SYS_CALL(lseek(fs.fd, get_offset_for_block_num(current_dst_block), SEEK_SET) < 0,
@@ -819,10 +865,12 @@ void cpHosttoFAT(char *src, char *dst) {
         first_block = false;
     }
 
-    // If empty file, set free firstBlock, firstBlock = 0xFFFF and return.
+    // If empty file, free all dst blocks, otherwise free whatever is left of the old dst.
     if (dst_de->size == 0) {
-        fs.fat_region[dst_de->firstBlock] = 0;
-        dst_de->firstBlock = EOF_IDX;
+        free_file_blocks(dst_de);
+    } else {
+        free_blocks_after(current_dst_block);
+        dst_de->lastBlock = current_dst_block;
     }
 
     write_dell();
@@ -31,6 +31,17 @@ void write_dell();
 // Return the next free block in the FAT
 int next_free_block();
 
+// Returns the last block of the file with directory entry de, or EOF_IDX if the file is empty.
+// Walks the FAT only if the last block isn't cached in de yet.
+uint16_t get_last_block(directory_entry *de);
+
+// Frees all the blocks of the file with directory entry de and makes it an empty file.
+void free_file_blocks(directory_entry *de);
+
+// Shrinks the file with directory entry de to len bytes, freeing only the blocks past the new end.
+// Lengths past the end of the file leave it unchanged.
+void truncate_file_blocks(directory_entry *de, int len);
+
 // Returns the offset in the FS for a given block number.
 off_t get_offset_for_block_num(uint16_t block_num);
 
@@ -56,6 +67,21 @@ bool mount(char *fs_name);
 // Unmounts the file system specified by fs.
 void umount();
 
+// Number of files listed per write by ls.
+#define LS_PAGE_ENTRIES 32
+
+// Upper bound on the length of a line of ls output, including the newline.
+#define LS_LINE_LENGTH 96
+
+// Fills stats with the stats of up to max files in the directory, starting from the directory
+// entry *cursor, and advances *cursor past them (to NULL once the directory is exhausted).
+// Deleted files are skipped. Returns the number of stats filled.
+int read_dir_batch(linked_list_elem **cursor, file_stat *stats, int max);
+
+// Formats the n files in stats as lines of ls output into page, which must hold at least
+// n * LS_LINE_LENGTH bytes. Returns the length of the output (not null-terminated).
+int format_ls_page(char *page, file_stat *stats, int n);
+
 // Touch creates a new file if none exists, otherwise updates the mmtime of the file.
 // Also returns a pointer to the directory_entry that was created/modified.
 directory_entry *touch(char *file);
@@ -6,6 +6,9 @@
 #include "../lib/fd.h"
 #include "../lib/errno.h"
 
+// Number of blocks allocated by writes so far.
+static unsigned long blocks_allocated = 0;
+
 int next_free_block_standalone(file_system *fs) {
     for (int i = 2; i < fs->num_fat_entries; i++) {
         if (fs->fat_region[i] == 0 && i != EOF_IDX) {
@@ -17,33 +20,72 @@ int next_free_block_standalone(file_system *fs) {
     return -1;
 }
 
-// Returns the file position for l_seek() given the current block (to start on) and the offset.
-int find_curr_block_in_fat(int curr_block, int offset, file_system *f_fs) {
-    while (offset > f_fs->block_size) {
-        // iterating by block_size chunks thru the FAT.
-        offset -= f_fs->block_size;
-        // iterating to the next block.
-        if (offset > 0) {
-            // if a new block is necessary, add it
-            // in this case, we need to pad the hole with '\0', and then set the offset.
-            if (f_fs->fat_region[curr_block] == EOF_IDX) {
-                f_fs->fat_region[curr_block] = next_free_block_standalone(f_fs);
-                if ((int) f_fs->fat_region[curr_block] == -1) {
-                    set_errno(NO_MORE_SPACE);
-                    return -1;
-                }
-                curr_block = f_fs->fat_region[curr_block];
-                f_fs->fat_region[curr_block] = EOF_IDX;
-            } else {
-                curr_block = f_fs->fat_region[curr_block];
+// Returns the block holding byte pos of the file, allocating the blocks up to it if allocate is
+// true. The walk starts from the closest of the first block, the block cached in the fd and the
+// cached last block of the file, so sequential access and appends don't walk the FAT.
+// Returns EOF_IDX if the block doesn't exist or there was no space left to allocate it.
+static uint16_t find_block(file_descriptor *file, int pos, bool allocate, file_system *f_fs) {
+    directory_entry *de = file->de;
+    int idx = pos / f_fs->block_size;
+
+    if (de->firstBlock == EOF_IDX) {
+        int first_block = allocate ? next_free_block_standalone(f_fs) : -1;
+        if (first_block == -1) {
+            return EOF_IDX;
+        }
+
+        f_fs->fat_region[first_block] = EOF_IDX;
+        de->firstBlock = first_block;
+        blocks_allocated++;
+    }
+
+    uint16_t block = de->firstBlock;
+    int block_idx = 0;
+
+    if (file->pos_block != EOF_IDX && file->pos_block_idx <= idx) {
+        block = file->pos_block;
+        block_idx = file->pos_block_idx;
+    }
+
+    if (de->size > 0) {
+        int last_idx = (de->size - 1) / f_fs->block_size;
+
+        if (last_idx <= idx && last_idx > block_idx) {
+            block = get_last_block(de);
+            block_idx = last_idx;
+        }
+    }
+
+    while (block_idx < idx) {
+        uint16_t next_block = f_fs->fat_region[block];
+
+        // Allocate new block if necessary.
+        if (next_block == EOF_IDX) {
+            int new_block = allocate ? next_free_block_standalone(f_fs) : -1;
+            if (new_block == -1) {
+                return EOF_IDX;
             }
+
+            f_fs->fat_region[new_block] = EOF_IDX;
+            f_fs->fat_region[block] = new_block;
+            next_block = new_block;
+            blocks_allocated++;
         }
+
+        block = next_block;
+        block_idx++;
     }
 
-    return get_offset_for_block_num(curr_block) + offset;
+    file->pos_block = block;
+    file->pos_block_idx = block_idx;
+    return block;
 }
 
-int k_lseek(int fd, int offset, int whence, file_system *f_fs, linked_list *OFT) {
+unsigned long k_blocks_allocated() {
+    return blocks_allocated;
+}
+
+int k_lseek(int fd, int offset, int whence, file_system *f_fs, open_file_table *OFT) {
     // lseek() allows the file offset to be set beyond the end of the
     // file (but this does not change the size of the file).  If data is
     // later written at this point, subsequent reads of the data in the
@@ -57,166 +99,98 @@ int k_lseek(int fd, int offset, int whence, file_system *f_fs, linked_list *OFT)
         return -1;
     }
 
-    linked_list_elem *f = get_elem(OFT, OFT_find_fd_by_fd_predicate, &fd);
+    file_descriptor *file = oft_get(OFT, fd);
 
-    if (f == NULL) {
+    if (file == NULL) {
         set_errno(FILE_NOT_FOUND);
         return -1;
     }
 
-    file_descriptor *file = f->val;
-    int curr_block = file->de->firstBlock;
-    if (file->de->firstBlock == EOF_IDX) {
-        set_errno(UNALLOCATED_BLOCK);
-        return -1;
-    }
-
-    // We are at the beginning of the file.
     if (whence == F_SEEK_SET) {
-        // Iterate through the FAT to find the offset.
-        file->f_pos = find_curr_block_in_fat(curr_block, offset, f_fs);
-        if (file->f_pos == -1) {
-            set_errno(NO_MORE_SPACE);
-            return -1;
-        }
-        return 1;
+        file->f_pos = offset;
     } else if (whence == F_SEEK_CUR) {
-        if (file->f_pos + offset < file->de->size) {
-            // Basically adding the stuff in the current block to the offset since we'll be doing things by block sized chunks.
-            offset += (file->f_pos - f_fs->block_size) % f_fs->block_size;
-            // Note that the block num is always offset by the directory block.
-            // Hence, we subtract by the block size and then we divide by the block_size.
-            int temp = next_free_block_standalone(f_fs);
-            if (temp == -1) {
-                set_errno(NO_MORE_SPACE);
-                return -1;
-            }
-            curr_block =
-                    curr_block == EOF_IDX ? temp : (file->f_pos - f_fs->block_size) / f_fs->block_size;
-            file->f_pos = find_curr_block_in_fat(curr_block, offset, f_fs);
-            if (file->f_pos == -1){
-                set_errno(NO_MORE_SPACE);
-                return -1;
-            }
-        } else {
-            // Get the last block of the file in the FAT.
-            file->f_pos = find_curr_block_in_fat(curr_block, file->de->size, f_fs);
-            if (file->f_pos == -1){
-                set_errno(NO_MORE_SPACE);
-                return -1;
-            }
-
-            // Now write a bunch of 0's.
-            if (offset > 0) {
-                char hole[offset];
-                memset(hole, '\0', offset);
-                k_write(fd, offset, hole, f_fs, OFT);
-            }
-        }
-
-        return 1;
+        file->f_pos += offset;
     } else {
-        // Get the last block of the file in the FAT.
-        file->f_pos = find_curr_block_in_fat(curr_block, file->de->size, f_fs);
-        if (file->f_pos == -1){
-            set_errno(NO_MORE_SPACE);
-            return -1;
-        }
-
-        // now write a bunch of 0's
-        if (offset > 0) {
-            char hole[offset];
-            memset(hole, '\0', offset);
-            k_write(fd, offset, hole, f_fs, OFT);
-        }
-
-        return 1;
+        file->f_pos = file->de->size + offset;
     }
+
+    return 1;
 }
 
-int k_read(int fd, int n, char *buf, file_system *f_fs, linked_list *OFT) {
-    linked_list_elem *f = get_elem(OFT, OFT_find_fd_by_fd_predicate, &fd);
+int k_read(int fd, int n, char *buf, file_system *f_fs, open_file_table *OFT) {
+    file_descriptor *file = oft_get(OFT, fd);
 
-    if (f == NULL) {
+    if (file == NULL) {
         return -1;
     }
 
-    file_descriptor *file = f->val;
-
-    // Not reading anything.
-    if (n == 0) {
-        return 0;
-    }
-
     directory_entry *de = file->de;
-
-    // Empty file, so not reading anything.
-    if (de->size == 0) {
-        return 0;
-    }
-
-    if (file->f_pos == -1) {
-        k_lseek(fd, 0, F_SEEK_SET, f_fs, OFT);
-    }
-
-    int current_block = get_block_num_from_offset(file->f_pos);
-    int offset = get_offset_within_block(file->f_pos);
-
     int total_bytes_read = 0;
 
-    int bytes_before_loc = 0;
-    int block = de->firstBlock;
-
-    while (block != current_block) {
-        block = f_fs->fat_region[block];
-        bytes_before_loc += f_fs->block_size;
-    }
-
-    bytes_before_loc += offset;
-
-    int bytes_remaining_in_file = de->size - bytes_before_loc;
-
-    // END OF FILE.
-    if (bytes_remaining_in_file <= 0) {
-        return 0;
-    }
+    while (total_bytes_read < n && file->f_pos < de->size) {
+        uint16_t current_block = find_block(file, file->f_pos, false, f_fs);
+        if (current_block == EOF_IDX) {
+            break;
+        }
 
-    while (n > 0 && bytes_remaining_in_file > 0 && current_block != EOF_IDX) {
         // Read whichever is smaller, n bytes, remainder of file, or the rest of the block.
-        int bytes_to_read = MIN(n, MIN(bytes_remaining_in_file, f_fs->block_size - offset));
+        int offset = file->f_pos % f_fs->block_size;
+        int bytes_to_read = MIN(n - total_bytes_read, MIN(de->size - file->f_pos, f_fs->block_size - offset));
 
         HANDLE_SYS_CALL(lseek(f_fs->fd, get_offset_for_block_num(current_block) + offset, SEEK_SET) < 0,
                         "lseek: Issue k_read from fs\n");
         HANDLE_SYS_CALL(read(f_fs->fd, buf + total_bytes_read, bytes_to_read) < 0, "read: Issue k_read from fs\n");
 
         total_bytes_read += bytes_to_read;
-        n -= bytes_to_read;
-        bytes_remaining_in_file -= bytes_to_read;
+        file->f_pos += bytes_to_read;
+    }
 
-        // Reset offset after first block.
-        offset = 0;
+    return total_bytes_read;
+}
 
-        if (bytes_remaining_in_file > 0 && n > 0) {
-            current_block = f_fs->fat_region[current_block];
+// Writes n bytes of buf at byte pos of the file, growing the file if the write goes past its end.
+// Pre-Condition: pos is at most the size of the file.
+// Returns the number of bytes written, which is less than n if the FS ran out of space.
+static int write_at(file_descriptor *file, int pos, const char *buf, int n, file_system *f_fs) {
+    directory_entry *de = file->de;
+    int total_bytes_written = 0;
+
+    while (total_bytes_written < n) {
+        uint16_t current_block = find_block(file, pos + total_bytes_written, true, f_fs);
+        if (current_block == EOF_IDX) {
+            break;
         }
+
+        // Write whichever is smaller: n bytes or the rest of the block.
+        int offset = (pos + total_bytes_written) % f_fs->block_size;
+        int bytes_to_write = MIN(n - total_bytes_written, f_fs->block_size - offset);
+
+        HANDLE_SYS_CALL(lseek(f_fs->fd, get_offset_for_block_num(current_block) + offset, SEEK_SET) < 0,
+                        "lseek: Issue k_write from fs\n");
+        HANDLE_SYS_CALL(write(f_fs->fd, buf + total_bytes_written, bytes_to_write) < 0,
+                        "write: Issue k_write from fs\n");
+
+        total_bytes_written += bytes_to_write;
     }
 
-    file->f_pos = get_offset_for_block_num(current_block) + ((bytes_before_loc + total_bytes_read) % f_fs->block_size);
+    // Wrote up to the end of the file, so the last block written is now the last block.
+    if (total_bytes_written > 0 && pos + total_bytes_written >= de->size) {
+        de->size = pos + total_bytes_written;
+        de->lastBlock = file->pos_block;
+    }
 
-    return total_bytes_read;
+    return total_bytes_written;
 }
 
-int k_write(int fd, int n, char *buf, file_system *f_fs, linked_list *OFT) {
-    linked_list_elem *f = get_elem(OFT, OFT_find_fd_by_fd_predicate, &fd);
+int k_write(int fd, int n, char *buf, file_system *f_fs, open_file_table *OFT) {
+    file_descriptor *file = oft_get(OFT, fd);
 
-    if (f == NULL) {
+    if (file == NULL) {
         return -1;
     }
 
-    file_descriptor *file = f->val;
-
     // Insufficient permissions.
-    if (file->mode != F_WRITE && file->mode != F_APPEND) {
+    if (file->mode != F_WRITE && file->mode != F_APPEND && file->mode != F_OVERWRITE) {
         set_errno(PERMISSION_DENIED);
         return -1;
     }
@@ -228,69 +202,53 @@ int k_write(int fd, int n, char *buf, file_system *f_fs, linked_list *OFT) {
 
     directory_entry *de = file->de;
 
-    // New file.
-    if (file->f_pos == -1) {
-        de->firstBlock = next_free_block_standalone(f_fs);
-        if ((int) de->firstBlock == -1) {
-            set_errno(NO_MORE_SPACE);
-            return -1;
-        }
-        f_fs->fat_region[de->firstBlock] = EOF_IDX;
-        k_lseek(fd, 0, F_SEEK_SET, f_fs, OFT);
+    // Appends always go to the end of the file, wherever f_pos is.
+    if (file->mode == F_APPEND) {
+        file->f_pos = de->size;
     }
 
-    int current_block = get_block_num_from_offset(file->f_pos);
-    int offset = get_offset_within_block(file->f_pos);
-
-    int total_bytes_written = 0;
+    // The position is past the end of the file, so fill the hole up to it with '\0's first.
+    if (file->f_pos > de->size) {
+        char hole[f_fs->block_size];
+        memset(hole, '\0', f_fs->block_size);
 
-    int block = de->firstBlock;
-    int bytes_before_loc = 0;
+        while (de->size < file->f_pos) {
+            int hole_size = MIN(file->f_pos - de->size, f_fs->block_size);
 
-    while (block != current_block) {
-        block = f_fs->fat_region[block];
-        bytes_before_loc += f_fs->block_size;
+            if (write_at(file, de->size, hole, hole_size, f_fs) < hole_size) {
+                write_dell();
+                set_errno(NO_MORE_SPACE);
+                return -1;
+            }
+        }
     }
 
-    bytes_before_loc += offset;
+    int total_bytes_written = write_at(file, file->f_pos, buf, n, f_fs);
 
-    while (n > 0) {
-        // Write whichever is smaller: n bytes or the rest of the block.
-        int bytes_to_write = MIN(n, f_fs->block_size - offset);
-
-        HANDLE_SYS_CALL(lseek(f_fs->fd, get_offset_for_block_num(current_block) + offset, SEEK_SET) < 0,
-                        "lseek: Issue k_write from fs\n");
-        HANDLE_SYS_CALL(write(f_fs->fd, buf + total_bytes_written, bytes_to_write) < 0,
-                        "write: Issue k_write from fs\n");
+    file->f_pos += total_bytes_written;
+    file->w_end = MAX(file->w_end, file->f_pos);
+    de->mtime = time(NULL);
+    write_dell();
 
-        total_bytes_written += bytes_to_write;
-        n -= bytes_to_write;
-
-        // Reset offset after first block.
-        offset = 0;
-
-        if (n > 0) {
-            // Allocate new block if necessary.
-            if (f_fs->fat_region[current_block] == EOF_IDX) {
-                f_fs->fat_region[current_block] = next_free_block_standalone(f_fs);
-                if ((int) f_fs->fat_region[current_block] == -1) {
-                    set_errno(NO_MORE_SPACE);
-                    return -1;
-                }
-            }
+    if (total_bytes_written < n) {
+        set_errno(NO_MORE_SPACE);
+        return -1;
+    }
 
-            current_block = f_fs->fat_region[current_block];
+    return total_bytes_written;
+}
 
-            if (f_fs->fat_region[current_block] == 0) {
-                f_fs->fat_region[current_block] = EOF_IDX;
-            }
-        }
+int k_truncate(directory_entry *de, int len, file_system *f_fs) {
+    if (len < 0) {
+        set_errno(INVALID_OFFSET);
+        return -1;
     }
 
-    de->mtime = time(NULL);
-    de->size = MAX(bytes_before_loc + total_bytes_written, de->size);
-    file->f_pos = get_offset_for_block_num(current_block) + (de->size % f_fs->block_size);
-    write_dell();
+    if (len < de->size) {
+        truncate_file_blocks(de, len);
+        de->mtime = time(NULL);
+        write_dell();
+    }
 
-    return total_bytes_written;
-}
\ No newline at end of file
+    return 1;
+}
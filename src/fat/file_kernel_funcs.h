@@ -2,14 +2,21 @@
 
 #pragma once
 
+#include "../lib/fd.h"
 #include "../lib/file_system.h"
-#include "../lib/linked_list.h"
 
 // Kernel level function for seeking within the FAT.
-int k_lseek(int fd, int offset, int whence, file_system *f_fs, linked_list *OFT);
+int k_lseek(int fd, int offset, int whence, file_system *f_fs, open_file_table *OFT);
 
 // Kernel level function for reading from the FAT.
-int k_read(int fd, int n, char *buf, file_system *f_fs, linked_list *OFT);
+int k_read(int fd, int n, char *buf, file_system *f_fs, open_file_table *OFT);
 
 // Kernel level function for writing to the FAT.
-int k_write(int fd, int n, char *buf, file_system *f_fs, linked_list *OFT);
\ No newline at end of file
+int k_write(int fd, int n, char *buf, file_system *f_fs, open_file_table *OFT);
+
+// Returns the number of FAT blocks k_write() has allocated so far.
+unsigned long k_blocks_allocated();
+
+// Kernel level function for shrinking a file in the FAT to len bytes. Only the blocks past
+// the new end of the file are freed. Lengths past the end of the file leave it unchanged.
+int k_truncate(directory_entry *de, int len, file_system *f_fs);
@@ -0,0 +1,171 @@
+// Definition of the console input driver.
+// The host's stdin raises SIGIO when input arrives. The handler only notes it and makes the
+// scheduler run, which moves the input into a line buffer in the kernel and wakes up the
+// processes waiting on stdin. The host's read() is only called once poll() says it won't block,
+// so jobs get the CPU while the shell waits at the prompt.
+
+// F_SETOWN_EX and gettid need the GNU extensions.
+#define _GNU_SOURCE
+
+#include "console.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "wait_queue.h"
+
+// Input read from the host that no process has read yet.
+static char line_buf[CONSOLE_BUFFER_SIZE];
+static int buf_len = 0;
+
+// Whether the host's stdin reached its end (or failed) after what's in the buffer.
+static bool at_eof = false;
+
+// Set by the SIGIO handler when input arrived. It starts set, since input may have arrived
+// before the signal was set up.
+static volatile sig_atomic_t input_pending = 1;
+
+// Processes waiting for a line.
+static wait_queue stdin_waiters;
+
+// Flags of the host's stdin before init_console(), or -1 if it has none.
+static int saved_flags = -1;
+
+// Signal handler for SIGIO. The input is read in the scheduler, which the SIGALRM makes run
+// as soon as this returns.
+static void input_handler(int signum) {
+    input_pending = 1;
+    raise(SIGALRM);
+}
+
+void init_console() {
+    init_wait_queue(&stdin_waiters);
+
+    struct sigaction act;
+    act.sa_handler = input_handler;
+    act.sa_flags = SA_RESTART;
+    sigfillset(&act.sa_mask);
+    sigaction(SIGIO, &act, NULL);
+
+    saved_flags = fcntl(STDIN_FILENO, F_GETFL);
+
+    if (saved_flags == -1) {
+        return;
+    }
+
+    // Only core 0 is signaled, the other cores' jobs aren't disturbed.
+    struct f_owner_ex owner = {.type = F_OWNER_TID, .pid = syscall(SYS_gettid)};
+    fcntl(STDIN_FILENO, F_SETOWN_EX, &owner);
+
+    // Not O_NONBLOCK, which a terminal's stdout would share. Regular files don't signal, but
+    // are always ready anyway.
+    fcntl(STDIN_FILENO, F_SETFL, saved_flags | O_ASYNC);
+}
+
+void restore_console() {
+    if (saved_flags != -1) {
+        fcntl(STDIN_FILENO, F_SETFL, saved_flags);
+    }
+}
+
+// Returns whether reading the host's stdin wouldn't block. A signal, e.g. the timer's, may
+// interrupt poll() even with no timeout, which doesn't mean there's input. A closed stdin reads as
+// the end of the input.
+static bool input_ready() {
+    struct pollfd fd = {.fd = STDIN_FILENO, .events = POLLIN};
+    int ready;
+
+    do {
+        ready = poll(&fd, 1, 0);
+    } while (ready == -1 && errno == EINTR);
+
+    return ready > 0 && (fd.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) != 0;
+}
+
+// Reads whatever input the host has into the buffer, without blocking.
+static void fill_buffer() {
+    while (buf_len < CONSOLE_BUFFER_SIZE && !at_eof && input_ready()) {
+        int bytes_read = read(STDIN_FILENO, line_buf + buf_len, CONSOLE_BUFFER_SIZE - buf_len);
+
+        if (bytes_read > 0) {
+            buf_len += bytes_read;
+        } else if (bytes_read == -1 && errno == EINTR) {
+            continue;
+        } else {
+            at_eof = true;
+        }
+    }
+}
+
+// Returns the length of the first line in the buffer, including its newline, or -1 if it isn't
+// all there yet. It's 0 if the buffer is empty and the input has ended.
+static int line_length() {
+    char *newline = memchr(line_buf, '\n', buf_len);
+
+    if (newline != NULL) {
+        return newline - line_buf + 1;
+    }
+
+    if (at_eof || buf_len == CONSOLE_BUFFER_SIZE) {
+        return buf_len;
+    }
+
+    return -1;
+}
+
+bool poll_console() {
+    if (!input_pending) {
+        return false;
+    }
+
+    // Cleared first, so input that arrives during the read is polled for again.
+    input_pending = 0;
+    fill_buffer();
+
+    if (stdin_waiters.head == NULL || line_length() == -1) {
+        return false;
+    }
+
+    wake_up_all(&stdin_waiters);
+    return true;
+}
+
+int console_read(char *buf, int n) {
+    int len;
+
+    while (true) {
+        len = line_length();
+
+        if (len == -1) {
+            fill_buffer();
+            len = line_length();
+        }
+
+        if (len != -1) {
+            break;
+        }
+
+        wait_on(&stdin_waiters);
+    }
+
+    if (len == 0) {
+        // Like a terminal's end of file, it's only reported once, after which reading goes on.
+        at_eof = false;
+        return 0;
+    }
+
+    if (n > len) {
+        n = len;
+    }
+
+    memcpy(buf, line_buf, n);
+    memmove(line_buf, line_buf + n, buf_len - n);
+    buf_len -= n;
+
+    return n;
+}
@@ -0,0 +1,25 @@
+// Declaration of the console input driver, which reads the host's stdin without blocking
+// the core a process waiting for input runs on.
+
+#pragma once
+
+#include <stdbool.h>
+
+// Size of the kernel's line buffer. A longer line is handed out in pieces of this size.
+#define CONSOLE_BUFFER_SIZE 4096
+
+// Has the host's stdin signal the calling host thread when input arrives. Has to be called by
+// core 0 before the scheduler starts.
+void init_console();
+
+// Gives the host's stdin back the flags it had before init_console().
+void restore_console();
+
+// Moves the input that arrived since the last call into the line buffer, and wakes up the
+// processes waiting for it. Returns whether any was woken up. Called by the scheduler.
+bool poll_console();
+
+// Reads up to n bytes of the next line of input, including its newline, into buf, blocking the
+// calling process until a whole line is there. Returns the number of bytes read, or 0 once the
+// input has ended. Has to be called in a system call.
+int console_read(char *buf, int n);
@@ -1,7 +1,10 @@
 // Main file for Penn OS.
 #include "pcb_table.h"
 
+#include "console.h"
+#include "profiler.h"
 #include "scheduler.h"
+#include "stacks.h"
 #include "threads.h"
 
 #include "../fat/fat_util.h"
@@ -13,16 +16,78 @@
 
 #define DEFAULT_LOG_NAME "log/scheduler.log"
 
+#define USAGE "Usage: ./pennos fatfs [schedLog] [--tickless] [--quantum-{high,mid,low}=N{ms,us}] [--cores=N]\n"
+
+// Parses a time slice like 5ms or 500us into microseconds. Returns false if it's not valid.
+static bool parse_quantum(char *str, unsigned int *usec) {
+    char *unit;
+    unsigned long n = strtoul(str, &unit, 10);
+
+    if (unit == str || n == 0 || n > 60000000) {
+        return false;
+    }
+
+    if (strcmp(unit, "ms") == 0) {
+        *usec = n * 1000;
+    } else if (strcmp(unit, "us") == 0) {
+        *usec = n;
+    } else {
+        return false;
+    }
+
+    return *usec <= 60000000;
+}
+
+// Applies the command line option opt. Returns false if it's not a valid option.
+static bool parse_option(char *opt) {
+    if (strcmp(opt, "--tickless") == 0) {
+        set_tickless(true);
+        return true;
+    }
+
+    if (strncmp(opt, "--cores=", strlen("--cores=")) == 0) {
+        char *end;
+        long n = strtol(opt + strlen("--cores="), &end, 10);
+        return *end == '\0' && n <= MAX_CORES && set_num_cores(n);
+    }
+
+    char *priorities[] = {"--quantum-high=", "--quantum-mid=", "--quantum-low="};
+
+    for (int i = 0; i < 3; i++) {
+        size_t len = strlen(priorities[i]);
+        unsigned int usec;
+
+        if (strncmp(opt, priorities[i], len) == 0) {
+            return parse_quantum(opt + len, &usec) && set_quantum(i - 1, usec);
+        }
+    }
+
+    return false;
+}
+
 int main(int argc, char **argv) {
-    HANDLE_INVALID_INPUT(argc < 2 || argc > 3, "Usage: ./pennos fatfs [schedLog]\n");
+    // Options can go anywhere, so they're filtered out of the positional arguments.
+    char *args[3];
+    int num_args = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            HANDLE_INVALID_INPUT(!parse_option(argv[i]), USAGE);
+        } else {
+            HANDLE_INVALID_INPUT(num_args == 3, USAGE);
+            args[num_args++] = argv[i];
+        }
+    }
+
+    HANDLE_INVALID_INPUT(num_args < 2, USAGE);
 
     // Starting up the filesystem.
-    if (f_mount(argv[1]) < 0) {
+    if (f_mount(args[1]) < 0) {
         return 0;
     } 
 
-    if (argc == 3) {
-        init_log(argv[2]);
+    if (num_args == 3) {
+        init_log(args[2]);
     } else {
         init_log(DEFAULT_LOG_NAME);
     }
@@ -37,17 +102,32 @@ int main(int argc, char **argv) {
 
     init_shell();
 
+    init_console();
+
+    start_cores();
+
     start_scheduler_thread();
 
     // Re-entry point once the shell exits.
+    join_cores();
+
+    restore_console();
+
+    // The events still in memory are written while the processes they name are around.
+    close_log();
+    free_profiler();
+
+#ifdef SYSSTAT
+    print_syscall_stats(stderr, -1);
+#endif
 
     // Free everything
     free_init_contexts();
     f_unmount();
     free_scheduler_resources();
     free_process_table();
+    free_stack_pool();
     free_bg_queue();
-    close_log();
 
     return 0;
 }
@@ -2,29 +2,111 @@
 
 #include "pcb_table.h"
 
-linked_list process_table;
+#include <stdint.h>
+
+// PCBs indexed by their pid. NULL if no process has the pid.
+static pcb *process_table[MAX_PID];
+
+// Bitmap of the pids in use. Bit i of word j is set iff pid (64 * j + i) is taken.
+// Pid 0 is always marked as taken, since it stands for "no parent".
+static uint64_t used_pids[PID_BITMAP_WORDS];
+
+// The pid the search for the next free pid starts from.
+static pid_t next_pid;
+
+// Number of PCBs in the table.
+static int num_pcbs;
 
 void init_pcb_table() {
-    init_linked_list(&process_table);
+    memset(process_table, 0, sizeof(process_table));
+    memset(used_pids, 0, sizeof(used_pids));
+    used_pids[0] = 1;
+    next_pid = 1;
+    num_pcbs = 0;
+}
+
+pid_t alloc_pid() {
+    int start_word = next_pid / 64;
+
+    // Visits the first word twice, since the free pids before next_pid in it are only taken after wrapping around.
+    for (int i = 0; i <= PID_BITMAP_WORDS; i++) {
+        int word = (start_word + i) % PID_BITMAP_WORDS;
+        uint64_t free_pids = ~used_pids[word];
+
+        if (i == 0) {
+            free_pids &= UINT64_MAX << (next_pid % 64);
+        }
+
+        if (free_pids != 0) {
+            pid_t pid = word * 64 + __builtin_ctzll(free_pids);
+            used_pids[word] |= 1ULL << (pid % 64);
+            next_pid = (pid + 1) % MAX_PID;
+            return pid;
+        }
+    }
+
+    return -1;
 }
 
 void add_pcb_to_table(pcb *to_add) {
-    push_back(&process_table, to_add);
+    if (process_table[to_add->pid] == NULL) {
+        num_pcbs++;
+    }
+
+    process_table[to_add->pid] = to_add;
+    used_pids[to_add->pid / 64] |= 1ULL << (to_add->pid % 64);
 }
 
 pcb *find_pcb_in_table(int pid) {
-    linked_list_elem *elem = get_elem(&process_table, pid_equal_predicate, &pid);
-    return elem == NULL ? NULL : elem->val;
+    return pid <= 0 || pid >= MAX_PID ? NULL : process_table[pid];
 }
 
 void delete_pcb_in_table(int pid) {
-    extract_elem(&process_table, pid_equal_predicate, &pid);
+    if (pid <= 0 || pid >= MAX_PID) {
+        return;
+    }
+
+    if (process_table[pid] != NULL) {
+        num_pcbs--;
+    }
+
+    process_table[pid] = NULL;
+    used_pids[pid / 64] &= ~(1ULL << (pid % 64));
 }
 
-linked_list *get_process_table() {
-    return &process_table;
+pcb *next_pcb_in_table(int pid) {
+    pid++;
+
+    while (pid < MAX_PID) {
+        uint64_t word = used_pids[pid / 64] & (UINT64_MAX << (pid % 64));
+
+        if (word == 0) {
+            pid = (pid / 64 + 1) * 64;
+            continue;
+        }
+
+        pid = (pid / 64) * 64 + __builtin_ctzll(word);
+
+        // The pid might be allocated to a process that isn't in the table yet.
+        if (process_table[pid] != NULL) {
+            return process_table[pid];
+        }
+
+        pid++;
+    }
+
+    return NULL;
+}
+
+int num_pcbs_in_table() {
+    return num_pcbs;
 }
 
 void free_process_table() {
-    clear(&process_table, free_process_pcb);
-}
\ No newline at end of file
+    pcb *proc;
+
+    // Freeing a PCB also frees (and removes) its children, so start over from the lowest pid each time.
+    while ((proc = next_pcb_in_table(0)) != NULL) {
+        free_process_pcb(proc);
+    }
+}
@@ -6,20 +6,34 @@
 #include "../lib/pcb.h"
 #include "../shell/shell.h"
 
+// Upper bound (exclusive) on pids. Pids are recycled once processes are freed.
+#define MAX_PID 32768
+
+// Number of 64 bit words in the pid bitmap.
+#define PID_BITMAP_WORDS (MAX_PID / 64)
+
 // Initialize an PCB Table.
 void init_pcb_table();
 
-// Add PCB to PCB Table.
+// Allocates a free pid. Pids are handed out in increasing order, wrapping around once
+// MAX_PID is reached, so a freed pid isn't reused right away. Returns -1 if all are taken.
+pid_t alloc_pid();
+
+// Add PCB to PCB Table under its pid.
 void add_pcb_to_table(pcb *to_add);
 
-// Find PCB in the linked list.
+// Find PCB in the table. Returns NULL if no process has the pid.
 pcb *find_pcb_in_table(int pid);
 
-// Delte PCB in the linked list. Does not free.
+// Delete PCB in the table and free its pid. Does not free the PCB.
 void delete_pcb_in_table(int pid);
 
-// Returns a pointer to the PCB table.
-linked_list *get_process_table();
+// Returns the PCB with the lowest pid greater than pid, or NULL if there is none.
+// Used to iterate over the table: for (pcb *p = next_pcb_in_table(0); p != NULL; p = next_pcb_in_table(p->pid)).
+pcb *next_pcb_in_table(int pid);
+
+// Returns the number of PCBs in the table.
+int num_pcbs_in_table();
 
 // Clears and frees all the entries in the entire PCB table.
 void free_process_table();
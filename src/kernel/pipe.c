@@ -0,0 +1,180 @@
+// Definition of kernel pipes.
+
+#include "pipe.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lib/errno.h"
+#include "../lib/macros.h"
+#include "../lib/tagged_alloc.h"
+
+kernel_pipe *create_pipe() {
+    kernel_pipe *p = (kernel_pipe *) tagged_malloc(MEM_PIPES, sizeof(kernel_pipe));
+
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->head = 0;
+    p->size = 0;
+    p->read_open = true;
+    p->write_open = true;
+    init_wait_queue(&p->readers);
+    init_wait_queue(&p->writers);
+
+    return p;
+}
+
+int pipe_read(kernel_pipe *p, char *buf, int n) {
+    while (p->size == 0) {
+        if (!p->write_open) {
+            return 0;
+        }
+
+        wait_on(&p->readers);
+    }
+
+    n = MIN(n, p->size);
+
+    // The bytes may wrap around the end of the buffer.
+    int first = MIN(n, PIPE_CAPACITY - p->head);
+    memcpy(buf, p->buf + p->head, first);
+    memcpy(buf + first, p->buf, n - first);
+
+    p->head = (p->head + n) % PIPE_CAPACITY;
+    p->size -= n;
+
+    wake_up_all(&p->writers);
+    return n;
+}
+
+int pipe_write(kernel_pipe *p, const char *buf, int n) {
+    int written = 0;
+
+    while (written < n) {
+        if (!p->read_open) {
+            break;
+        }
+
+        if (p->size == PIPE_CAPACITY) {
+            wait_on(&p->writers);
+            continue;
+        }
+
+        int tail = (p->head + p->size) % PIPE_CAPACITY;
+        int len = MIN(n - written, PIPE_CAPACITY - p->size);
+
+        // The free space may wrap around the end of the buffer.
+        int first = MIN(len, PIPE_CAPACITY - tail);
+        memcpy(p->buf + tail, buf + written, first);
+        memcpy(p->buf, buf + written + first, len - first);
+
+        p->size += len;
+        written += len;
+
+        wake_up_all(&p->readers);
+    }
+
+    if (written == 0 && n > 0) {
+        set_errno(BROKEN_PIPE);
+        return -1;
+    }
+
+    return written;
+}
+
+int pipe_peek(kernel_pipe *p, char **data) {
+    while (p->size == 0) {
+        if (!p->write_open) {
+            return 0;
+        }
+
+        wait_on(&p->readers);
+    }
+
+    *data = p->buf + p->head;
+    return MIN(p->size, PIPE_CAPACITY - p->head);
+}
+
+void pipe_consume(kernel_pipe *p, int n) {
+    p->head = (p->head + n) % PIPE_CAPACITY;
+    p->size -= n;
+
+    wake_up_all(&p->writers);
+}
+
+int pipe_reserve(kernel_pipe *p, char **space) {
+    while (p->read_open && p->size == PIPE_CAPACITY) {
+        wait_on(&p->writers);
+    }
+
+    if (!p->read_open) {
+        set_errno(BROKEN_PIPE);
+        return -1;
+    }
+
+    int tail = (p->head + p->size) % PIPE_CAPACITY;
+    *space = p->buf + tail;
+    return MIN(PIPE_CAPACITY - p->size, PIPE_CAPACITY - tail);
+}
+
+void pipe_commit(kernel_pipe *p, int n) {
+    p->size += n;
+
+    wake_up_all(&p->readers);
+}
+
+int pipe_splice(kernel_pipe *in, kernel_pipe *out, int n) {
+    // Waits for both pipes before touching either, since another process may read or write them
+    // while this one sleeps.
+    while (true) {
+        if (in->size == 0 && !in->write_open) {
+            return 0;
+        }
+
+        if (!out->read_open) {
+            set_errno(BROKEN_PIPE);
+            return -1;
+        }
+
+        if (in->size == 0) {
+            wait_on(&in->readers);
+        } else if (out->size == PIPE_CAPACITY) {
+            wait_on(&out->writers);
+        } else {
+            break;
+        }
+    }
+
+    n = MIN(n, MIN(in->size, PIPE_CAPACITY - out->size));
+
+    for (int moved = 0; moved < n;) {
+        int tail = (out->head + out->size) % PIPE_CAPACITY;
+        int len = MIN(n - moved, MIN(PIPE_CAPACITY - in->head, PIPE_CAPACITY - tail));
+
+        memcpy(out->buf + tail, in->buf + in->head, len);
+        in->head = (in->head + len) % PIPE_CAPACITY;
+        in->size -= len;
+        out->size += len;
+        moved += len;
+    }
+
+    wake_up_all(&in->writers);
+    wake_up_all(&out->readers);
+    return n;
+}
+
+void close_pipe_end(kernel_pipe *p, bool write_end) {
+    if (write_end) {
+        p->write_open = false;
+        wake_up_all(&p->readers);
+    } else {
+        p->read_open = false;
+        wake_up_all(&p->writers);
+    }
+
+    if (!p->read_open && !p->write_open) {
+        tagged_free(p);
+    }
+}
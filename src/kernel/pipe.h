@@ -0,0 +1,66 @@
+// Declaration of kernel pipes, bounded buffers that one process writes into and another reads from.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "wait_queue.h"
+
+// Number of bytes a pipe holds before writers have to wait for a reader.
+#define PIPE_CAPACITY 4096
+
+typedef struct kernel_pipe_st {
+    // Ring buffer of the bytes written but not read yet, which start at index head.
+    char buf[PIPE_CAPACITY];
+    int head;
+    int size;
+
+    // Whether the read and write ends are still open.
+    bool read_open;
+    bool write_open;
+
+    // Processes waiting for bytes to read, or for room to write.
+    wait_queue readers;
+    wait_queue writers;
+} kernel_pipe;
+
+// Dynamically allocates an empty pipe with both ends open.
+kernel_pipe *create_pipe();
+
+// Reads up to n bytes from the pipe into buf, blocking the calling process until there's at
+// least one. Returns the number of bytes read, or 0 once the pipe is empty and its write end is
+// closed. Has to be called in a system call.
+int pipe_read(kernel_pipe *p, char *buf, int n);
+
+// Writes the n bytes of buf into the pipe, blocking the calling process while it's full.
+// Returns n, or the number of bytes written before the read end was closed. Returns -1 and sets
+// BROKEN_PIPE if it was closed before any was. Has to be called in a system call.
+int pipe_write(kernel_pipe *p, const char *buf, int n);
+
+// Blocks the calling process until the pipe has bytes to read or its write end is closed. Points
+// *data at the first byte in the pipe's buffer and returns how many follow it contiguously, or 0
+// at end of file. They stay in the pipe until pipe_consume(), so only one reader of the pipe
+// should be reading it in place. Has to be called in a system call.
+int pipe_peek(kernel_pipe *p, char **data);
+
+// Removes the first n bytes, which were read in place after pipe_peek(), from the pipe.
+void pipe_consume(kernel_pipe *p, int n);
+
+// Blocks the calling process until the pipe has room or its read end is closed. Points *space at
+// the pipe's free buffer space and returns how many bytes fit there contiguously. Returns -1 and
+// sets BROKEN_PIPE once the read end is closed. Only one writer of the pipe should be writing it
+// in place. Has to be called in a system call.
+int pipe_reserve(kernel_pipe *p, char **space);
+
+// Adds the n bytes written in place at the space from pipe_reserve() to the pipe.
+void pipe_commit(kernel_pipe *p, int n);
+
+// Moves up to n bytes from the pipe in to the pipe out, blocking the calling process until in has
+// bytes and out has room for them, or until either can't change anymore. Returns the number of
+// bytes moved, or 0 at in's end of file. Returns -1 and sets BROKEN_PIPE once out's read end is
+// closed. in and out have to be different pipes. Has to be called in a system call.
+int pipe_splice(kernel_pipe *in, kernel_pipe *out, int n);
+
+// Closes the read or the write end of the pipe, waking up whoever waits on the other one.
+// The pipe is freed once both are closed.
+void close_pipe_end(kernel_pipe *p, bool write_end);
@@ -2,73 +2,117 @@
 
 #include "process_kernel_funcs.h"
 
+#include "pcb_table.h"
+#include "scheduler.h"
+#include "wait_queue.h"
 #include "../lib/linked_list.h"
 #include "../lib/log.h"
 #include "../lib/signals.h"
+#include "../lib/tagged_alloc.h"
 #include "../user/file_user_funcs.h"
 
-static int univCounter = 2;
-
 pcb *k_process_create(pcb *parent) {
-    pcb *child = (pcb *) malloc(sizeof(pcb));
+    pid_t pid = alloc_pid();
+
+    if (pid == -1) {
+        return NULL;
+    }
+
+    pcb *child = (pcb *) tagged_malloc(MEM_PCBS, sizeof(pcb));
 
     if (child == NULL) {
         perror("malloc");
+        delete_pcb_in_table(pid);
         return NULL;
     }
 
     child->status = RUNNING;
     child->status_changed = false;
-    child->context = (ucontext_t *) malloc(sizeof(ucontext_t));
-    child->pid = univCounter;
+    child->context = (ucontext_t *) tagged_malloc(MEM_CONTEXTS, sizeof(ucontext_t));
+    child->pid = pid;
     child->is_bg = false;
     child->blocked = 0;
-    univCounter++;
 
     child->parent = parent;
 
     child->argv = NULL;
 
-    linked_list *zombie_list = (linked_list *) malloc(sizeof(linked_list));
+    linked_list *zombie_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
     init_linked_list(zombie_list);
     child->zombieLL = zombie_list;
 
-    linked_list *child_list = (linked_list *) malloc(sizeof(linked_list));
+    linked_list *child_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
     init_linked_list(child_list);
     child->childLL = child_list;
 
-    child->priority = parent->priority;
+    linked_list *changed_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
+    init_linked_list(changed_list);
+    child->changedLL = changed_list;
 
-    for (int i = 2; i < MAX_OPEN_FDS; i++) {
-        child->fd[i] = parent->fd[i];
-    }
+    child->child_wait = (wait_queue *) tagged_malloc(MEM_PCBS, sizeof(wait_queue));
+    init_wait_queue(child->child_wait);
+    child->wait_prev = NULL;
+    child->wait_next = NULL;
+    child->wait_queue = NULL;
+
+    child->priority = parent->priority;
+    child->run_prev = NULL;
+    child->run_next = NULL;
+    child->run_queue = NOT_QUEUED;
+    child->core = parent->core;
+    child->kernel_depth = 0;
+    child->preemptible = false;
+    child->error = NOERROR;
+    child->timer_prev = NULL;
+    child->timer_next = NULL;
+    child->timer_slot = NOT_SLEEPING;
+
+    // The child only gets its own copy of the table once either process opens or closes a file.
+    child->fds = share_fd_table(parent->fds);
+    child->streams = NULL;
+    memset(&child->usage, 0, sizeof(proc_usage));
+#ifdef SYSSTAT
+    child->syscalls = NULL;
+    child->errors_set = 0;
+#endif
 
     push_back(parent->childLL, child);
 
     return child;
 }
 
+// Records that process's status changed, for its parent's p_waitpid, and wakes the parent up
+// if it's waiting for that.
+static void notify_parent(pcb *process) {
+    if (!process->status_changed) {
+        process->status_changed = true;
+        push_back(process->parent->changedLL, process);
+    }
+
+    wake_up_all(process->parent->child_wait);
+}
+
 void k_process_kill(pcb *process, int signal) {
+    // Signals are often sent while the sender is the only job, with no timer going.
+    sync_clock_ticks();
+
     if (process->status != EXITED) {
         log_event(SIGNALED_EVT, process);
     }
 
+    // If it's running on another core, that core has to notice it's been stopped or killed.
+    preempt_job(process);
+
     if (signal == S_SIGSTOP && process->status == RUNNING) {
         process->status = STOPPED;
-        process->status_changed = 1;
 
         // Logging.
         log_event(STOPPED_EVT, process);
 
-        // If parent is blocked because of child process, resume parent.
         if (process->parent != NULL) {
-            if (process->parent->blocked == 1) {
-                process->parent->blocked = 0;
-
-                // Logging.
-                log_event(UNBLOCKED_EVT, process->parent);
-                add_job_to_scheduler(process->parent);
-            }
+            notify_parent(process);
+        } else {
+            process->status_changed = 1;
         }
     } else if (signal == S_SIGCONT && process->status == STOPPED) {
         process->status = RUNNING;
@@ -82,12 +126,9 @@ void k_process_kill(pcb *process, int signal) {
     } else if (signal == S_SIGTERM && process->status != TERMINATED &&
                process->status != ORPHANED) {
         // Terminate if process is not already terminated or orphaned.
-        process->status_changed = 1;
-
-        // Remove from sleep queue on SIGTERM, if applicable.
-        if (get_sleep_queue() != NULL) {
-            extract_elem(get_sleep_queue(), pid_equal_predicate, &process->pid);
-        }
+        // Remove from sleep queue and whatever it's waiting on on SIGTERM, if applicable.
+        cancel_sleep_alarm(process);
+        cancel_wait(process);
 
         // Close child fd's on termination.
         f_close_child_fd(process);
@@ -131,26 +172,44 @@ void k_process_kill(pcb *process, int signal) {
             extract_elem(process->parent->childLL, pid_equal_predicate,
                          &process->pid);
             push_back(process->parent->zombieLL, process);
-
-            if (process->parent->blocked == 1) {
-                process->parent->blocked = 0;
-
-                // Logging.
-                log_event(UNBLOCKED_EVT, process->parent);
-                add_job_to_scheduler(process->parent);
-            }
+            notify_parent(process);
         } else {
             // THIS IS THE SHELL CASE.
+            process->status_changed = 1;
             process->context->uc_link = 0;
         }
     }
 }
 
+// Makes sure process and its descendants, which are freed along with it, don't run again.
+// Returns true if any of them is still running on another core.
+static bool still_running(pcb *process) {
+    process->blocked = true;
+    remove_job_from_scheduler(process);
+
+    bool running = preempt_job(process);
+    linked_list *lists[2] = {process->childLL, process->zombieLL};
+
+    for (int i = 0; i < 2; i++) {
+        for (linked_list_elem *elem = lists[i]->head; elem != NULL; elem = elem->next) {
+            running |= still_running(elem->val);
+        }
+    }
+
+    return running;
+}
+
 void k_process_cleanup(pcb *process) {
     if (process != NULL) {
         if (process->status == TERMINATED || process->status == EXITED ||
             process->status == ORPHANED) {
 
+            // With several cores, a process that's been killed may still be running on another
+            // core until that core reschedules.
+            while (get_num_cores() > 1 && still_running(process)) {
+                pause_kernel();
+            }
+
             // Remove children from queues and free them.
             int s1 = process->zombieLL->size;
             for (int i = 0; i < s1; i++) {
@@ -0,0 +1,86 @@
+// Definition of the sampling profiler.
+// The samples are written by the SIGALRM handler of whichever core the timer went off on, so
+// slots in the ring are claimed with an atomic counter rather than under the kernel lock.
+
+#include "profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcb_table.h"
+#include "../lib/tagged_alloc.h"
+
+static profile_sample ring[PROFILE_RING_SIZE];
+
+// Number of samples taken since the profiler was started. The next one goes in slot
+// num_samples % PROFILE_RING_SIZE.
+static long long num_samples = 0;
+
+static bool running = false;
+
+// Command of every pid that ran while the profiler did, since pids are recycled and processes
+// are freed before their samples are looked at.
+static char *names[MAX_PID];
+
+void start_profiler() {
+    free_profiler();
+
+    __atomic_store_n(&num_samples, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&running, true, __ATOMIC_SEQ_CST);
+}
+
+void stop_profiler() {
+    __atomic_store_n(&running, false, __ATOMIC_SEQ_CST);
+}
+
+bool profiler_running() {
+    return __atomic_load_n(&running, __ATOMIC_RELAXED);
+}
+
+void record_profile_sample(pid_t pid, void *pc) {
+    if (!profiler_running()) {
+        return;
+    }
+
+    long long idx = __atomic_fetch_add(&num_samples, 1, __ATOMIC_RELAXED);
+    ring[idx % PROFILE_RING_SIZE] = (profile_sample) {.pid = pid, .pc = pc};
+}
+
+void note_profiled_process(pcb *job) {
+    if (!profiler_running()) {
+        return;
+    }
+
+    char *name = names[job->pid];
+
+    // A recycled pid gets the command of its latest process.
+    if (name == NULL || strcmp(name, job->cmd) != 0) {
+        tagged_free(name);
+        names[job->pid] = tagged_strdup(MEM_PROFILING, job->cmd);
+    }
+}
+
+int get_profile_samples(profile_sample *out, long long *dropped) {
+    long long total = __atomic_load_n(&num_samples, __ATOMIC_SEQ_CST);
+    int count = total < PROFILE_RING_SIZE ? total : PROFILE_RING_SIZE;
+    int oldest = (total - count) % PROFILE_RING_SIZE;
+
+    // The samples may wrap around the end of the ring.
+    int first = PROFILE_RING_SIZE - oldest < count ? PROFILE_RING_SIZE - oldest : count;
+    memcpy(out, ring + oldest, first * sizeof(profile_sample));
+    memcpy(out + first, ring, (count - first) * sizeof(profile_sample));
+
+    *dropped = total - count;
+    return count;
+}
+
+const char *profiled_process_name(pid_t pid) {
+    return pid >= 0 && pid < MAX_PID ? names[pid] : NULL;
+}
+
+void free_profiler() {
+    for (int i = 0; i < MAX_PID; i++) {
+        tagged_free(names[i]);
+        names[i] = NULL;
+    }
+}
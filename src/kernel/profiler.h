@@ -0,0 +1,47 @@
+// Declaration of the sampling profiler, which records which process was running, and where,
+// every clock tick.
+
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "../lib/pcb.h"
+
+// Number of samples kept. Once it's full, the oldest are overwritten.
+#define PROFILE_RING_SIZE 65536
+
+typedef struct profile_sample_st {
+    pid_t pid;
+
+    // Instruction pointer of the process when the timer went off.
+    void *pc;
+} profile_sample;
+
+// Drops the samples taken so far and starts sampling. Has to be called in a system call.
+void start_profiler();
+
+// Stops sampling. The samples are kept until the profiler is started again.
+void stop_profiler();
+
+// Returns whether the profiler is sampling.
+bool profiler_running();
+
+// Records that the process with the pid was running at pc. Called from the timer's signal handler.
+void record_profile_sample(pid_t pid, void *pc);
+
+// Remembers the command of job, which is about to run, so samples of it can be told apart once
+// it's gone. Called by the scheduler.
+void note_profiled_process(pcb *job);
+
+// Copies the samples, oldest first, into out, which holds PROFILE_RING_SIZE of them. Returns the
+// number copied, and stores the number of older ones that were overwritten in dropped. Has to be
+// called in a system call.
+int get_profile_samples(profile_sample *out, long long *dropped);
+
+// Returns the command of the process with the pid when it was sampled, or NULL if it never ran
+// while the profiler did.
+const char *profiled_process_name(pid_t pid);
+
+// Frees the profiler's resources.
+void free_profiler();
@@ -1,174 +1,672 @@
+// REG_RIP and gettid need the GNU extensions.
+#define _GNU_SOURCE
 
 #include "scheduler.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <ucontext.h>
 #include <unistd.h>
 
+#include "console.h"
 #include "pcb_table.h"
+#include "profiler.h"
 #include "threads.h"
+#include "wait_queue.h"
 
 #include "../lib/errno.h"
 #include "../lib/linked_list.h"
 #include "../lib/log.h"
 #include "../lib/pcb.h"
+#include "../lib/tagged_alloc.h"
 #include "../shell/shell.h"
 
-#define THREAD_COUNT 9 + 6 + 4
+// Number of priority levels, i.e. scheduler queues.
+#define NUM_PRIORITIES 3
+
+// Length of a clock tick.
+#define TICK_NSEC (1000000000LL / TICKS_PER_SECOND)
+
+// Load averages are sampled this often, like the host's.
+#define LOAD_SAMPLE_NSEC (5 * 1000000000LL)
+
+// Older glibc headers don't name the thread a SIGEV_THREAD_ID timer signals.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// Bounds of the executable's own code, from the linker.
+extern char __executable_start[];
+extern char etext[];
+
+// A scheduler queue. The jobs in it are linked through their run_prev and run_next fields,
+// so no list nodes are allocated and any job can be unlinked in O(1).
+typedef struct run_queue_st {
+    pcb *head;
+    pcb *tail;
+    int size;
+} run_queue;
+
+// A host thread running its own instance of the scheduler, with its own queues and timer.
+typedef struct core_st {
+    pthread_t thread;
+
+    // Timer that sends the core's SIGALRM, on CLOCK_MONOTONIC.
+    timer_t timer;
+
+    // When the timer is set to go off, in nanoseconds since boot (-1 if it isn't).
+    long long timer_deadline;
+
+    // The core's scheduler queues indexed by priority + 1, i.e. high, mid, low.
+    run_queue queues[NUM_PRIORITIES];
+
+    // The credit each queue has built up towards its next dispatch.
+    int credits[NUM_PRIORITIES];
+
+    pcb *active_job;
+
+    // When the active job's time slice is over, in nanoseconds since boot.
+    long long slice_end;
+
+    // Whether the timer is set to go off at the end of the active job's time slice.
+    bool preempting;
+
+    // Whether the core is waiting for work in its idle context.
+    bool idle;
+
+    // Whether the core is running its scheduler.
+    bool in_scheduler;
+
+    // Whether the timer went off while the active job couldn't be preempted.
+    bool need_resched;
+
+    // Whether the core's thread holds the kernel lock.
+    bool holds_kernel_lock;
+
+    // Kernel depth of whatever runs on the core without an active job, e.g. a signal handler in the idle context.
+    int kernel_depth;
+} core;
+
+static core cores[MAX_CORES];
+static int num_cores = 1;
+
+// With more than one core, kernel code runs under this lock. A job takes it on entering a system
+// call and the scheduler runs with it held, so it's passed along with the CPU when a job blocks.
+static pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set once the shell logs out, to stop every core.
+static bool shutting_down = false;
 
 static pcb *shell_job;
-static pcb *active_job;
 
-int counter = 0;
-char *random_str = NULL;
+// Time slice of each priority in nanoseconds, indexed by priority + 1.
+static long long quanta[NUM_PRIORITIES] = {DEFAULT_QUANTUM_USEC * 1000LL, DEFAULT_QUANTUM_USEC * 1000LL,
+                                           DEFAULT_QUANTUM_USEC * 1000LL};
+
+// In tickless mode, a job that has its core to itself isn't preempted and an idle scheduler
+// isn't woken up until a sleeper is due.
+static bool tickless = false;
+
+// Whether the last turn of the timer wheel or the last console input woke up any process.
+static bool woke_job = false;
+
+// When the scheduler started, i.e. clock tick 0.
+static struct timespec boot_time;
+
+// Relative share of dispatches of each queue.
+static int weights[NUM_PRIORITIES] = {HIGH_PRIORITY_WEIGHT, MID_PRIORITY_WEIGHT, LOW_PRIORITY_WEIGHT};
 
-static const int centisecond = 10000; // 10 milliseconds
+// The 1, 5 and 15 minute load averages, and how much of each is kept per sample, i.e.
+// e^(-5/60), e^(-5/300) and e^(-5/900).
+static double load_averages[3];
+static const double load_decay[3] = {0.920044415, 0.983471454, 0.994459848};
 
-static linked_list high;
-static linked_list mid;
-static linked_list low;
+// When the load averages are sampled next, in nanoseconds since boot.
+static long long next_load_sample = LOAD_SAMPLE_NSEC;
 
-static linked_list sleep_jobs;
+static void update_timer(core *c);
+static void set_timer_at(core *c, long long deadline);
 
 bool after_suspend = false;
 
-// Generates a random ordering of high, mid, and low priority jobs.
-static void random_string() {
-    if (random_str != NULL) {
-        free(random_str);
+// Returns the core the calling host thread runs, or NULL if it isn't one. Jobs move between
+// threads, so this is looked up every time rather than kept in a thread-local variable whose
+// address the compiler could reuse across a context switch.
+static __attribute__((noinline)) core *current_core() {
+    pthread_t self = pthread_self();
+
+    for (int i = 0; i < num_cores; i++) {
+        if (pthread_equal(cores[i].thread, self)) {
+            return &cores[i];
+        }
+    }
+
+    return NULL;
+}
+
+int current_core_id() {
+    core *c = current_core();
+    return c == NULL ? 0 : c - cores;
+}
+
+// Blocks the signals that can switch jobs or enter the kernel, saving the old mask in old_set.
+static void block_preemption(sigset_t *old_set) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTSTP);
+    sigprocmask(SIG_BLOCK, &set, old_set);
+}
+
+static void lock_kernel(core *c) {
+    if (num_cores > 1) {
+        pthread_mutex_lock(&kernel_lock);
+        c->holds_kernel_lock = true;
+    }
+}
+
+static void unlock_kernel(core *c) {
+    if (num_cores > 1) {
+        c->holds_kernel_lock = false;
+        pthread_mutex_unlock(&kernel_lock);
+    }
+}
+
+// Returns the kernel depth of whatever runs on core c.
+static int *kernel_depth(core *c) {
+    return c->active_job != NULL ? &c->active_job->kernel_depth : &c->kernel_depth;
+}
+
+int enter_kernel() {
+    if (num_cores == 1) {
+        return 0;
+    }
+
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    core *c = current_core();
+
+    if (c != NULL && !c->in_scheduler && (*kernel_depth(c))++ == 0) {
+        lock_kernel(c);
+    }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+    return 0;
+}
+
+void exit_kernel(int *unused) {
+    if (num_cores == 1) {
+        catch_up_log();
+        return;
     }
 
-    random_str = (char *) malloc((THREAD_COUNT + 1) * sizeof(char));
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    core *c = current_core();
 
-    char *start = "HHHHHHHHHMMMMMMLLLL";
-    strcpy(random_str, start);
+    if (c != NULL && !c->in_scheduler && --(*kernel_depth(c)) == 0) {
+        catch_up_log();
+        unlock_kernel(c);
 
-    if (THREAD_COUNT > 1) {
-        for (int i = 0; i < THREAD_COUNT; i++) {
-            int j = rand() % THREAD_COUNT;
-            const char temp = random_str[j];
-            random_str[j] = random_str[i];
-            random_str[i] = temp;
+        // The timer went off during the system call.
+        if (c->need_resched && c->active_job != NULL) {
+            switch_context(c->active_job->context, get_scheduler_context());
         }
     }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
 }
 
-// Add a new running job to scheduler queues
-void add_job_to_scheduler(pcb *job) {
-    extract_elem(&high, pid_equal_predicate, &job->pid);
-    extract_elem(&mid, pid_equal_predicate, &job->pid);
-    extract_elem(&low, pid_equal_predicate, &job->pid);
-
-    if (job->priority == -1) {
-        push_back(&high, job);
-    } else if (job->priority == 0) {
-        push_back(&mid, job);
-    } else {
-        push_back(&low, job);
+int leave_kernel() {
+    if (num_cores == 1) {
+        return 0;
+    }
+
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    core *c = current_core();
+    pcb *job = c->active_job;
+    int depth = job->kernel_depth;
+
+    job->kernel_depth = 0;
+    job->preemptible = true;
+
+    if (depth > 0) {
+        unlock_kernel(c);
     }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+    return depth;
 }
 
-// When job status changes and is not running, remove it from scheduler queues
-bool remove_job_from_scheduler(pcb *proc) {
-    linked_list_elem *h = extract_elem(&high, pid_equal_predicate, &(proc->pid));
-    linked_list_elem *m = extract_elem(&mid, pid_equal_predicate, &(proc->pid));
-    linked_list_elem *l = extract_elem(&low, pid_equal_predicate, &(proc->pid));
+void return_to_kernel(int depth) {
+    if (num_cores == 1) {
+        return;
+    }
+
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    // The job may have been moved to another core in the meantime.
+    core *c = current_core();
+    pcb *job = c->active_job;
+
+    job->preemptible = false;
+    job->kernel_depth = depth;
+
+    if (depth > 0) {
+        lock_kernel(c);
+    }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+}
+
+// Makes core c run its scheduler.
+static void kick_core(core *c) {
+    pthread_kill(c->thread, SIGALRM);
+}
+
+// Returns the core job is running on, or NULL if it isn't running.
+static core *running_core(pcb *job) {
+    for (int i = 0; i < num_cores; i++) {
+        if (cores[i].active_job == job && !cores[i].in_scheduler) {
+            return &cores[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool preempt_job(pcb *job) {
+    core *c = running_core(job);
+
+    if (c == NULL || c == current_core()) {
+        return false;
+    }
+
+    kick_core(c);
+    return true;
+}
+
+void pause_kernel() {
+    core *c = current_core();
+
+    unlock_kernel(c);
+    sched_yield();
+    lock_kernel(c);
+}
+
+// Returns the number of jobs waiting in core c's queues.
+static int num_queued_jobs(core *c) {
+    return c->queues[0].size + c->queues[1].size + c->queues[2].size;
+}
+
+// Picks the queue of core c to dispatch from with smooth weighted round-robin: every non-empty
+// queue earns its weight in credit, and the one with the most credit wins and pays back the total
+// earned. Each queue then gets its share of the dispatches, spread out evenly rather than in bursts.
+// Pre-Condition: at least one of the queues is non-empty.
+static run_queue *pick_queue(core *c) {
+    int total_weight = 0;
+    int best = -1;
+
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        if (c->queues[i].size == 0) {
+            continue;
+        }
+
+        c->credits[i] += weights[i];
+        total_weight += weights[i];
+
+        if (best == -1 || c->credits[i] > c->credits[best]) {
+            best = i;
+        }
+    }
+
+    c->credits[best] -= total_weight;
+    return &c->queues[best];
+}
+
+bool set_scheduler_weights(int high_weight, int mid_weight, int low_weight) {
+    if (high_weight <= 0 || mid_weight <= 0 || low_weight <= 0) {
+        return false;
+    }
+
+    weights[0] = high_weight;
+    weights[1] = mid_weight;
+    weights[2] = low_weight;
+
+    // Credit built up under the old weights would skew the new ratio.
+    for (int i = 0; i < num_cores; i++) {
+        memset(cores[i].credits, 0, sizeof(cores[i].credits));
+    }
+
+    return true;
+}
+
+void get_scheduler_weights(int out[3]) {
+    memcpy(out, weights, sizeof(weights));
+}
+
+// Adds the time job spent in its current state to its usage, and moves it to state.
+static void set_usage_state(pcb *job, usage_state state) {
+    long long now = nsec_since_boot();
+    long long elapsed = now - job->usage.state_since;
+
+    if (job->usage.state == USAGE_RUNNING) {
+        job->usage.run_nsec += elapsed;
+    } else if (job->usage.state == USAGE_WAITING) {
+        job->usage.wait_nsec += elapsed;
+    } else if (job->usage.state == USAGE_BLOCKED) {
+        job->usage.blocked_nsec += elapsed;
+    }
 
-    bool success = h != NULL || m != NULL || l != NULL;
+    job->usage.state = state;
+    job->usage.state_since = now;
+}
+
+void get_process_usage(pcb *job, proc_usage *usage) {
+    *usage = job->usage;
 
-    // if (!success) {
-    //     set_errno(NOTFOUNDINSCHEDULER);
-    // }
+    // Only the time until the last change of state has been added.
+    long long elapsed = nsec_since_boot() - job->usage.state_since;
 
-    return success;
+    if (usage->state == USAGE_RUNNING) {
+        usage->run_nsec += elapsed;
+    } else if (usage->state == USAGE_WAITING) {
+        usage->wait_nsec += elapsed;
+    } else if (usage->state == USAGE_BLOCKED) {
+        usage->blocked_nsec += elapsed;
+    }
 }
 
-void set_sleep_alarm(unsigned int ticks, pcb *job) {
-    job->remaining_clock_ticks = ticks;
-    push_back(&sleep_jobs, job);
+// Appends job to the queue for its priority on core c.
+static void run_queue_push(core *c, pcb *job) {
+    int queue_idx = job->priority == -1 ? 0 : (job->priority == 0 ? 1 : 2);
+    run_queue *queue = &c->queues[queue_idx];
+
+    job->run_prev = queue->tail;
+    job->run_next = NULL;
+
+    if (queue->tail != NULL) {
+        queue->tail->run_next = job;
+    } else {
+        queue->head = job;
+    }
+
+    queue->tail = job;
+    queue->size++;
+    job->run_queue = queue_idx;
+    job->core = c - cores;
+
+    if (job->usage.state != USAGE_WAITING) {
+        set_usage_state(job, USAGE_WAITING);
+    }
 }
 
-linked_list *get_sleep_queue() {
-    if (is_empty(&sleep_jobs)) {
-        return NULL;
+// Unlinks job from the queue it's in.
+// Pre-Condition: job is in a queue.
+static void run_queue_unlink(pcb *job) {
+    run_queue *queue = &cores[job->core].queues[job->run_queue];
+
+    if (job->run_prev != NULL) {
+        job->run_prev->run_next = job->run_next;
     } else {
-        return &sleep_jobs;
+        queue->head = job->run_next;
+    }
+
+    if (job->run_next != NULL) {
+        job->run_next->run_prev = job->run_prev;
+    } else {
+        queue->tail = job->run_prev;
+    }
+
+    queue->size--;
+    job->run_prev = NULL;
+    job->run_next = NULL;
+    job->run_queue = NOT_QUEUED;
+}
+
+// Picks the core a job that's ready to run goes to: the one it last ran on, unless that one
+// is busy and another is idle.
+static core *select_core(pcb *job) {
+    core *last = &cores[job->core];
+
+    if (last->idle) {
+        return last;
+    }
+
+    for (int i = 0; i < num_cores; i++) {
+        if (cores[i].idle) {
+            return &cores[i];
+        }
     }
+
+    return last;
 }
 
-pcb *decrement_ticks_in_sleep_queue() {
-    linked_list *job_queue = get_sleep_queue();
+// Moves a job to core c from the core with the most queued jobs, if that one has work to spare:
+// any at all when c has none, otherwise at least two jobs more than c, so they don't trade
+// the same job back and forth.
+static void steal_job(core *c) {
+    core *victim = NULL;
+
+    for (int i = 0; i < num_cores; i++) {
+        if (&cores[i] != c && (victim == NULL || num_queued_jobs(&cores[i]) > num_queued_jobs(victim))) {
+            victim = &cores[i];
+        }
+    }
+
+    int own = num_queued_jobs(c);
 
-    if (job_queue == NULL) {
-        return NULL;
+    if (victim == NULL || num_queued_jobs(victim) == 0 || (own > 0 && num_queued_jobs(victim) < own + 2)) {
+        return;
     }
 
-    pcb *finished;
-    bool found_one_finished_job = false;
+    // The job that would've waited the longest there.
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        pcb *job = victim->queues[i].tail;
+
+        if (job != NULL) {
+            run_queue_unlink(job);
+            run_queue_push(c, job);
+            return;
+        }
+    }
+}
 
-    // Check if any sleep jobs are force terminated.
-    linked_list alrd_terminated_jobs;
-    init_linked_list(&alrd_terminated_jobs);
+// Add a new running job to scheduler queues
+void add_job_to_scheduler(pcb *job) {
+    // A job that's still running goes back in a queue once its core's scheduler runs.
+    if (running_core(job) != NULL) {
+        return;
+    }
 
-    if (!is_empty(job_queue)) {
-        linked_list_elem *curr = job_queue->head;
+    if (job->run_queue != NOT_QUEUED) {
+        run_queue_unlink(job);
+    }
 
-        while (curr != NULL) {
-            pcb *curr_pcb = curr->val;
+    core *c = select_core(job);
+    run_queue_push(c, job);
 
-            // Only update counters if sleep job is running.
-            if (curr_pcb->status == RUNNING || curr_pcb->status == STOPPED) {
-                curr_pcb->remaining_clock_ticks = curr_pcb->remaining_clock_ticks - 1;
+    if (c->idle) {
+        c->idle = false;
 
-                if (curr_pcb->remaining_clock_ticks <= 0 && !found_one_finished_job && curr_pcb->status == RUNNING) {
-                    finished = curr_pcb;
-                    found_one_finished_job = true;
-                }
-            } else if (curr_pcb->status == TERMINATED || curr_pcb->status == ORPHANED) {
-                push_back(&alrd_terminated_jobs, &(curr_pcb->pid));
+        if (c != current_core()) {
+            kick_core(c);
+        }
+    } else if (tickless) {
+        // The active jobs now have to share the CPUs, so their time slices have to be enforced again.
+        for (int i = 0; i < num_cores; i++) {
+            if (!cores[i].preempting && cores[i].active_job != NULL) {
+                update_timer(&cores[i]);
             }
+        }
+    }
+}
+
+// When job status changes and is not running, remove it from scheduler queues
+bool remove_job_from_scheduler(pcb *proc) {
+    if (proc->run_queue == NOT_QUEUED) {
+        return false;
+    }
+
+    run_queue_unlink(proc);
+    set_usage_state(proc, proc->blocked ? USAGE_BLOCKED : USAGE_IDLE);
+    return true;
+}
+
+// Wakes up a job whose sleep is over. A stopped job is only put back in the
+// scheduler queues once it's continued.
+static void wake_sleeper(pcb *job) {
+    if (job->status != RUNNING && job->status != STOPPED) {
+        return;
+    }
 
-            curr = curr->next;
+    job->blocked = false;
+    log_event(UNBLOCKED_EVT, job);
+
+    if (job->status == RUNNING) {
+        add_job_to_scheduler(job);
+        woke_job = true;
+    }
+}
+
+long long nsec_since_boot() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - boot_time.tv_sec) * 1000000000LL + (now.tv_nsec - boot_time.tv_nsec);
+}
+
+// Returns the number of jobs that are running or waiting to, on every core.
+static int num_active_jobs() {
+    int n = 0;
+
+    for (int i = 0; i < num_cores; i++) {
+        pcb *job = cores[i].active_job;
+        n += num_queued_jobs(&cores[i]);
+
+        if (job != NULL && job->run_queue == NOT_QUEUED && job->status == RUNNING && !job->blocked) {
+            n++;
         }
     }
 
-    // Remove the forced terminated sleep jobs
-    for (int i = 0; i < alrd_terminated_jobs.size; i++) {
-        pid_t *pid_ptr = (pop_head(&alrd_terminated_jobs));
-        extract_elem(job_queue, pid_equal_predicate, pid_ptr);
+    return n;
+}
+
+// Samples the number of active jobs into the load averages if a sample is due. Samples missed
+// while the scheduler didn't run, e.g. in tickless mode, are made up with the current number.
+static void update_load_averages() {
+    long long now = nsec_since_boot();
+
+    if (now < next_load_sample) {
+        return;
+    }
+
+    int n = num_active_jobs();
+
+    while (next_load_sample <= now) {
+        for (int i = 0; i < 3; i++) {
+            load_averages[i] = load_averages[i] * load_decay[i] + n * (1 - load_decay[i]);
+        }
+
+        next_load_sample += LOAD_SAMPLE_NSEC;
     }
+}
 
-    // Remove the completed sleep job from sleep queue 
-    if (found_one_finished_job) {
-        extract_elem(job_queue, pid_equal_predicate, &(finished->pid));
-        return finished;
-    } else {
-        return NULL;
+void get_load_averages(double out[3]) {
+    memcpy(out, load_averages, sizeof(load_averages));
+}
+
+// Advances the clock ticks to however many ticks have gone by since the scheduler started,
+// and wakes up the sleepers due by then.
+static void catch_up_clock_ticks() {
+    unsigned int ticks = nsec_since_boot() / TICK_NSEC;
+
+    while ((int) (ticks - get_clock_ticks()) > 0) {
+        increment_clock_ticks();
+    }
+
+    expire_sleep_alarms(get_clock_ticks(), wake_sleeper);
+}
+
+void sync_clock_ticks() {
+    sigset_t alarm_set, old_set;
+    sigemptyset(&alarm_set);
+    sigaddset(&alarm_set, SIGALRM);
+
+    sigprocmask(SIG_BLOCK, &alarm_set, &old_set);
+    catch_up_clock_ticks();
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+}
+
+// Returns the instruction pointer saved in context uc, or NULL if it isn't known on this platform.
+static char *saved_pc(ucontext_t *uc) {
+#if defined(__x86_64__)
+    return (char *) uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__aarch64__)
+    return (char *) uc->uc_mcontext.pc;
+#else
+    return NULL;
+#endif
+}
+
+// Returns whether the job interrupted at context uc can be switched out. With one core it
+// always can. With more, glibc takes real locks, so a job can't be switched out while it's
+// in the kernel or anywhere in libc, unless it's waiting in suspend().
+static bool can_preempt(pcb *job, ucontext_t *uc) {
+    if (num_cores == 1 || job->preemptible) {
+        return true;
+    }
+
+    if (job->kernel_depth > 0) {
+        return false;
     }
+
+    char *pc = saved_pc(uc);
+    return pc == NULL || (pc >= __executable_start && pc < etext);
 }
 
-// Signal handler for SIGALRM.
-static void alarm_handler(int signum) {
-    increment_clock_ticks();
-    pcb *to_handle = decrement_ticks_in_sleep_queue();
+// Signal handler for SIGALRM, which either the core's timer or another core sends.
+static void alarm_handler(int signum, siginfo_t *info, void *uc) {
+    core *c = current_core();
+
+    if (c == NULL) {
+        return;
+    }
+
+    // Only the timer's own signals are samples, not other cores kicking this one.
+    if (info->si_code == SI_TIMER && c->active_job != NULL && !c->in_scheduler) {
+        record_profile_sample(c->active_job->pid, saved_pc(uc));
+    }
+
+    if (c->active_job != NULL && !can_preempt(c->active_job, uc)) {
+        // The job gives up the CPU on its way out of the kernel, or the timer tries again next tick.
+        c->need_resched = true;
 
-    if (to_handle != NULL) {
-        to_handle->blocked = false;
-        add_job_to_scheduler(to_handle);
-        log_event(UNBLOCKED_EVT, to_handle);
+        if (c->active_job->kernel_depth == 0) {
+            set_timer_at(c, nsec_since_boot() + TICK_NSEC);
+        }
+
+        return;
     }
 
     // Make sure you're not switching to NULL scheduler.
     if (get_scheduler_context() != NULL) {
-        if (active_job != NULL) {
-            swapcontext(active_job->context, get_scheduler_context());
+        if (c->active_job != NULL) {
+            switch_context(c->active_job->context, get_scheduler_context());
         } else {
             ucontext_t dummycontext;
-            swapcontext(&dummycontext, get_scheduler_context());
+            switch_context(&dummycontext, get_scheduler_context());
         }
     }
 }
@@ -176,24 +674,144 @@ static void alarm_handler(int signum) {
 // Registers the ALRM handler.
 static void set_alarm_handler(void) {
     struct sigaction act;
-    act.sa_handler = alarm_handler;
-    act.sa_flags = SA_RESTART;
+    act.sa_sigaction = alarm_handler;
+    act.sa_flags = SA_RESTART | SA_SIGINFO;
     sigfillset(&act.sa_mask);
     sigaction(SIGALRM, &act, NULL);
 }
 
-// Sets the timer to send a SIGALRM on every tick.
-static void set_timer(void) {
-    struct itimerval it;
+// Creates the timer of core c, which sends the SIGALRM to the calling thread.
+static void create_timer(core *c) {
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGALRM;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+
+    HANDLE_SYS_CALL(timer_create(CLOCK_MONOTONIC, &sev, &c->timer) < 0, "Error creating the scheduler timer.");
+    c->timer_deadline = -1;
+}
+
+// Sets the timer of core c to go off once, at deadline nanoseconds since boot. If the deadline
+// has already gone by, it goes off right away. A negative deadline disarms it.
+static void set_timer_at(core *c, long long deadline) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    if (deadline >= 0) {
+        long long nsec = boot_time.tv_nsec + deadline;
+        its.it_value.tv_sec = boot_time.tv_sec + nsec / 1000000000LL;
+        its.it_value.tv_nsec = nsec % 1000000000LL;
+    }
+
+    timer_settime(c->timer, TIMER_ABSTIME, &its, NULL);
+    c->timer_deadline = deadline;
+}
+
+// Returns when the wheel next has to turn for a sleeper, in nanoseconds since boot, or -1 if nothing sleeps.
+static long long next_sleeper_deadline() {
+    unsigned int next_tick;
+
+    if (!next_sleep_alarm(&next_tick)) {
+        return -1;
+    }
+
+    // Clock ticks wrap around, so the alarm is placed relative to the current tick.
+    long long now_tick = nsec_since_boot() / TICK_NSEC;
+    return (now_tick + (int) (next_tick - (unsigned int) now_tick)) * TICK_NSEC;
+}
+
+// Returns the number of jobs that want core c: the queued ones, including those on other cores,
+// which c can take over, and the active one if it's still running.
+static int num_runnable_jobs(core *c) {
+    int n = 0;
+
+    for (int i = 0; i < num_cores; i++) {
+        n += num_queued_jobs(&cores[i]);
+    }
+
+    if (c->active_job != NULL && c->active_job->run_queue == NOT_QUEUED && c->active_job->status == RUNNING &&
+        !c->active_job->blocked) {
+        n++;
+    }
+
+    return n;
+}
+
+// Sets the timer of core c to go off at the end of the active job's time slice or, on core 0,
+// which keeps time for the sleepers, when the wheel next has to turn, whichever comes first.
+// An idle scheduler is woken up every default quantum, except in tickless mode, where a job
+// that has its core to itself isn't preempted and an idle scheduler only wakes up for sleepers.
+static void update_timer(core *c) {
+    long long deadline = -1;
+    c->preempting = false;
+
+    if (c->active_job != NULL) {
+        if (!tickless || num_runnable_jobs(c) > 1) {
+            deadline = c->slice_end;
+            c->preempting = true;
+        }
+
+        // The profiler samples the active job every tick.
+        if (profiler_running()) {
+            long long sample = nsec_since_boot() + TICK_NSEC;
+
+            if (deadline < 0 || sample < deadline) {
+                deadline = sample;
+            }
+        }
+    } else if (!tickless) {
+        deadline = nsec_since_boot() + DEFAULT_QUANTUM_USEC * 1000LL;
+    }
+
+    if (c == &cores[0]) {
+        long long alarm = next_sleeper_deadline();
+
+        if (alarm >= 0 && (deadline < 0 || alarm < deadline)) {
+            deadline = alarm;
+        }
+    }
+
+    set_timer_at(c, deadline);
+}
+
+// Makes sure core 0's timer goes off in time for a sleeper added on another core.
+static void update_sleeper_timer() {
+    long long alarm = next_sleeper_deadline();
+
+    if (alarm >= 0 && (cores[0].timer_deadline < 0 || alarm < cores[0].timer_deadline)) {
+        update_timer(&cores[0]);
+    }
+}
+
+void set_tickless(bool enabled) {
+    tickless = enabled;
+}
+
+bool set_quantum(int priority, unsigned int usec) {
+    if (priority < -1 || priority > 1 || usec == 0) {
+        return false;
+    }
+
+    quanta[priority + 1] = usec * 1000LL;
+    return true;
+}
 
-    it.it_interval = (struct timeval) {.tv_usec = centisecond * 10};
-    it.it_value = it.it_interval;
+bool set_num_cores(int n) {
+    if (n < 1 || n > MAX_CORES) {
+        return false;
+    }
+
+    num_cores = n;
+    return true;
+}
 
-    setitimer(ITIMER_REAL, &it, NULL);
+int get_num_cores() {
+    return num_cores;
 }
 
 void add_shell_pcb_to_table() {
-    shell_job = (pcb *) malloc(sizeof(pcb));
+    shell_job = (pcb *) tagged_malloc(MEM_PCBS, sizeof(pcb));
     shell_job->pid = 1;
     shell_job->status = RUNNING;
     shell_job->status_changed = false;
@@ -202,151 +820,283 @@ void add_shell_pcb_to_table() {
     shell_job->context = get_shell_context();
 
     shell_job->parent = NULL;
-    shell_job->cmd = (char *) malloc(sizeof("shell"));
+    shell_job->cmd = (char *) tagged_malloc(MEM_ARGV, sizeof("shell"));
     strcpy(shell_job->cmd, "shell");
 
     shell_job->argv = NULL;
 
-    linked_list *zombie_list = (linked_list *) malloc(sizeof(linked_list));
+    linked_list *zombie_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
     init_linked_list(zombie_list);
     shell_job->zombieLL = zombie_list;
 
-    linked_list *child_list = (linked_list *) malloc(sizeof(linked_list));
+    linked_list *child_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
     init_linked_list(child_list);
     shell_job->childLL = child_list;
 
+    linked_list *changed_list = (linked_list *) tagged_malloc(MEM_PCBS, sizeof(linked_list));
+    init_linked_list(changed_list);
+    shell_job->changedLL = changed_list;
+
+    shell_job->child_wait = (wait_queue *) tagged_malloc(MEM_PCBS, sizeof(wait_queue));
+    init_wait_queue(shell_job->child_wait);
+    shell_job->wait_prev = NULL;
+    shell_job->wait_next = NULL;
+    shell_job->wait_queue = NULL;
+
     shell_job->priority = -1;
+    shell_job->run_prev = NULL;
+    shell_job->run_next = NULL;
+    shell_job->run_queue = NOT_QUEUED;
+    shell_job->core = 0;
+    shell_job->kernel_depth = 0;
+    shell_job->preemptible = false;
+    shell_job->timer_prev = NULL;
+    shell_job->timer_next = NULL;
+    shell_job->timer_slot = NOT_SLEEPING;
+    shell_job->error = NOERROR;
 
     shell_job->fd[0] = STDIN_FILENO;
     shell_job->fd[1] = STDOUT_FILENO;
 
-    shell_job->is_bg = false;
+    shell_job->fds = create_fd_table();
+    shell_job->streams = NULL;
+    memset(&shell_job->usage, 0, sizeof(proc_usage));
+#ifdef SYSSTAT
+    shell_job->syscalls = NULL;
+    shell_job->errors_set = 0;
+#endif
 
-    for (int i = 2; i < MAX_OPEN_FDS; i++) {
-        shell_job->fd[i] = EMPTY_FD;
-    }
+    shell_job->is_bg = false;
 
     add_pcb_to_table(shell_job);
 
     return;
 }
 
-void init_sleep_queue() {
-    init_linked_list(&sleep_jobs);
-}
-
 void init_shell() {
     add_shell_pcb_to_table();
-    active_job = shell_job;
-
-    add_job_to_scheduler(active_job);
+    add_job_to_scheduler(shell_job);
 }
 
 void init_scheduler(void) {
-    init_linked_list(&high);
-    init_linked_list(&mid);
-    init_linked_list(&low);
-    active_job = NULL;
+    memset(cores, 0, sizeof(cores));
+    cores[0].thread = pthread_self();
 
+    clock_gettime(CLOCK_MONOTONIC, &boot_time);
     set_alarm_handler();
-    set_timer();
+    create_timer(&cores[0]);
+    update_timer(&cores[0]);
 
     return;
 }
 
+// Main function of the host thread of every core but core 0.
+static void *core_main(void *arg) {
+    core *c = arg;
+    c->thread = pthread_self();
+
+    init_core_contexts(c - cores);
+    create_timer(c);
+    start_scheduler_thread();
+
+    return NULL;
+}
+
+void start_cores() {
+    for (int i = 1; i < num_cores; i++) {
+        HANDLE_SYS_CALL(pthread_create(&cores[i].thread, NULL, core_main, &cores[i]) != 0,
+                        "Error starting a core.");
+    }
+}
+
+void join_cores() {
+    for (int i = 1; i < num_cores; i++) {
+        pthread_join(cores[i].thread, NULL);
+    }
+}
+
+void shutdown_scheduler() {
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    core *c = current_core();
+
+    lock_kernel(c);
+    shutting_down = true;
+
+    for (int i = 0; i < num_cores; i++) {
+        if (&cores[i] != c) {
+            kick_core(&cores[i]);
+        }
+    }
+
+    unlock_kernel(c);
+    switch_context(c->active_job->context, get_scheduler_context());
+}
+
 pcb *get_active_job(void) {
-    return active_job;
+    if (num_cores == 1) {
+        return cores[0].active_job;
+    }
+
+    // Without the signals blocked, the caller could move to another core halfway through.
+    sigset_t old_set;
+    block_preemption(&old_set);
+
+    core *c = current_core();
+    pcb *job = c == NULL ? NULL : c->active_job;
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+    return job;
 }
 
 void reset_active_job() {
-    active_job = NULL;
-}
+    core *c = current_core();
 
-void free_no_op(void *val) {}
+    if (c != NULL) {
+        c->active_job = NULL;
+    }
+}
 
 void free_scheduler_resources() {
-    // Don't free the values, because they'll be freed by PCB Table.
-    clear(&high, free_no_op);
-    clear(&mid, free_no_op);
-    clear(&low, free_no_op);
-    clear(&sleep_jobs, free_no_op);
-    free(random_str);
+    // Don't free the jobs, because they'll be freed by PCB Table.
+    for (int i = 0; i < num_cores; i++) {
+        for (int j = 0; j < NUM_PRIORITIES; j++) {
+            while (cores[i].queues[j].head != NULL) {
+                run_queue_unlink(cores[i].queues[j].head);
+            }
+        }
+
+        cores[i].active_job = NULL;
+        timer_delete(cores[i].timer);
+    }
 
     shell_job = NULL;
-    active_job = NULL;
-    random_str = NULL;
 }
 
-// This is used for the idle process.
+// This is used for the idle process, and by jobs that have to wait.
 void suspend(void) {
+    pcb *job = get_active_job();
+
+    // The next SIGALRM might be a whole time slice away, so a job that's waiting
+    // hands the CPU back to the scheduler right away.
+    if (job != NULL) {
+        sigset_t old_set;
+        block_preemption(&old_set);
+
+        // A job waiting in a system call mustn't keep the other cores out of the kernel.
+        int depth = leave_kernel();
+        switch_context(job->context, get_scheduler_context());
+        return_to_kernel(depth);
+
+        sigprocmask(SIG_SETMASK, &old_set, NULL);
+        return;
+    }
+
     sigset_t empty_set;
     sigemptyset(&empty_set);
     sigsuspend(&empty_set);
 }
 
+// Switches core c to job. The job keeps the kernel lock if it's in the middle of a system call.
+static void run_job(core *c, pcb *job) {
+    c->active_job = job;
+    c->in_scheduler = false;
+    set_usage_state(job, USAGE_RUNNING);
+    note_profiled_process(job);
+
+    if (job->kernel_depth == 0) {
+        unlock_kernel(c);
+    }
+
+    set_scheduler_uc_link(job->context);
+    resume_context(job->context);
+}
+
 // This schedules the next context
 void scheduler() {
-    if (active_job != NULL) {
-        // If active job is still running, add it back to queue.
-        if (active_job->status == RUNNING && active_job->blocked == 0) {
-            add_job_to_scheduler(active_job);
-        }
+    core *c = current_core();
+
+    if (!c->holds_kernel_lock) {
+        lock_kernel(c);
     }
 
-    // Reset active_job to NULL.
-    active_job = NULL;
+    c->in_scheduler = true;
+    c->idle = false;
+    c->need_resched = false;
 
-    // If all three queues are empty, switch to the idle context.
-    if (is_empty(&high) && is_empty(&mid) && is_empty(&low)) {
-        set_scheduler_uc_link(get_idle_context());
-        setcontext(get_idle_context());
-        return;
+    if (shutting_down) {
+        c->active_job = NULL;
+        c->in_scheduler = false;
+        unlock_kernel(c);
+        resume_context(get_os_context());
     }
 
-    // At this point, there is at least one ucontext in the queues.
-    bool checked_high = false;
-    bool checked_mid = false;
-    bool checked_low = false;
+    woke_job = false;
+    catch_up_clock_ticks();
+    update_load_averages();
+    catch_up_log();
 
-    random_string();
+    if (poll_console()) {
+        woke_job = true;
+    }
 
-    while (!(checked_high && checked_mid && checked_low)) {
-        if (counter == THREAD_COUNT) {
-            random_string();
-            counter = 0;
-        }
+    pcb *prev = c->active_job;
+    bool runnable = prev != NULL && prev->status == RUNNING && !prev->blocked;
 
-        char whichQueue = random_str[counter];
-        if (whichQueue == 'H') {
-            checked_high = true;
+    // The timer also goes off to turn the wheel and take profiler samples, and other cores kick
+    // this one when they hand it work, which shouldn't cut the active job's slice short (or
+    // preempt it at all, if its slice isn't enforced) unless a sleeper or a reader woke up.
+    if (runnable && !woke_job && (nsec_since_boot() < c->slice_end || !c->preempting)) {
+        update_timer(c);
+        run_job(c, prev);
+    }
 
-            if (!is_empty(&high)) {
-                active_job = pop_head(&high);
-                break;
-            }
-        } else if (whichQueue == 'M') {
-            checked_mid = true;
+    c->active_job = NULL;
 
-            if (!is_empty(&mid)) {
-                active_job = pop_head(&mid);
-                break;
-            }
-        } else {
-            checked_low = true;
+    // If active job is still running, add it back to queue.
+    if (runnable) {
+        prev->usage.involuntary_switches++;
+        add_job_to_scheduler(prev);
+    } else if (prev != NULL) {
+        prev->usage.voluntary_switches++;
+        set_usage_state(prev, prev->blocked ? USAGE_BLOCKED : USAGE_IDLE);
+    }
 
-            if (!is_empty(&low)) {
-                active_job = pop_head(&low);
-                break;
-            }
+    // Even out the load between the cores.
+    steal_job(c);
+
+    // If all three queues are empty, switch to the idle context.
+    if (num_queued_jobs(c) == 0) {
+        update_timer(c);
+
+        if (c != &cores[0]) {
+            update_sleeper_timer();
         }
 
-        counter = counter + 1;
+        c->idle = true;
+        c->in_scheduler = false;
+        unlock_kernel(c);
+
+        set_scheduler_uc_link(get_idle_context());
+        resume_context(get_idle_context());
+        return;
+    }
+
+    // At this point, there is at least one ucontext in the queues.
+    pcb *job = pick_queue(c)->head;
+    run_queue_unlink(job);
+    c->active_job = job;
+    c->slice_end = nsec_since_boot() + quanta[job->priority + 1];
+    update_timer(c);
+
+    if (c != &cores[0]) {
+        update_sleeper_timer();
     }
 
     // Logging.
-    log_event(SCHEDULE_EVT, active_job);
+    log_event(SCHEDULE_EVT, job);
 
     // Set context of newly scheduled job
-    set_scheduler_uc_link(active_job->context);
-    setcontext(active_job->context);
-}
\ No newline at end of file
+    run_job(c, job);
+}
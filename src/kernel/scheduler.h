@@ -11,20 +11,98 @@
 #include <unistd.h>
 #include <valgrind/valgrind.h>
 
+#include "syscall_stats.h"
+#include "timer_wheel.h"
 #include "../lib/linked_list.h"
 #include "../lib/pcb.h"
 
-// Registers the sleeping job with the sleep handler.
-void set_sleep_alarm(unsigned int ticks, pcb *job);
+// Default weights of the high, mid and low priority queues. While all three have runnable jobs,
+// they're dispatched from in this ratio.
+#define HIGH_PRIORITY_WEIGHT 9
+#define MID_PRIORITY_WEIGHT 6
+#define LOW_PRIORITY_WEIGHT 4
 
-// Initializes the sleep job linked list.
-void init_sleep_queue();
+// Maximum number of cores, i.e. host threads each running the scheduler.
+#define MAX_CORES 64
 
-// Returns a pointer to the sleep job linked list.
-linked_list *get_sleep_queue();
+// Marks the enclosing function or block as a system call: with more than one core, the calling
+// process holds the kernel lock and isn't preempted until it returns. Built with -DSYSSTAT, the
+// call is also counted and timed under the name of the enclosing function, see syscall_stats.h.
+#ifdef SYSSTAT
+#define SYSTEM_CALL()                                                                               \
+    static int syscall_id_ = -1;                                                                    \
+    syscall_frame kernel_call_ __attribute__((cleanup(exit_syscall), unused)) =                     \
+            enter_syscall(&syscall_id_, __func__)
+#else
+#define SYSTEM_CALL() int kernel_call_ __attribute__((cleanup(exit_kernel), unused)) = enter_kernel()
+#endif
 
-// Decrements the clock ticks in all pcbs stored in sleep queue. return one sleep job that finished.
-pcb *decrement_ticks_in_sleep_queue();
+// Default time slice of every priority, which is also how often an idle scheduler wakes up
+// outside of tickless mode.
+#define DEFAULT_QUANTUM_USEC 100000
+
+// Sets the weights of the high, mid and low priority queues. Takes effect on the next dispatch.
+// Returns false (and leaves the weights unchanged) if any of them isn't positive.
+bool set_scheduler_weights(int high_weight, int mid_weight, int low_weight);
+
+// Stores the weights of the high, mid and low priority queues in out.
+void get_scheduler_weights(int out[3]);
+
+// Sets the time slice of jobs of the given priority (-1, 0 or 1) in microseconds. Returns false
+// (and leaves it unchanged) if the priority isn't valid or the slice is 0.
+bool set_quantum(int priority, unsigned int usec);
+
+// Enables or disables tickless mode, in which a job that has the CPU to itself isn't preempted
+// and an idle scheduler only wakes up for sleepers. Must be called before init_scheduler().
+void set_tickless(bool enabled);
+
+// Sets the number of cores (1 to MAX_CORES). Returns false (and leaves it unchanged) if n is
+// out of range. Must be called before init_scheduler().
+bool set_num_cores(int n);
+
+// Returns the number of cores.
+int get_num_cores();
+
+// Returns the index of the core the calling host thread runs.
+int current_core_id();
+
+// Starts the host threads of every core but core 0, which is the calling thread.
+void start_cores();
+
+// Waits for the host threads of every core but core 0 to stop.
+void join_cores();
+
+// Stops every core. Core 0 goes back to the OS's main context.
+void shutdown_scheduler();
+
+// Entry and exit of a system call, see SYSTEM_CALL(). They nest.
+int enter_kernel();
+void exit_kernel(int *unused);
+
+// Lets the calling process out of the kernel while it waits for long, e.g. in suspend(), during
+// which it can be preempted. Returns what to pass to return_to_kernel() after.
+int leave_kernel();
+void return_to_kernel(int depth);
+
+// If job is running on another core, makes that core reschedule and returns true.
+bool preempt_job(pcb *job);
+
+// Lets the other cores into the kernel for a moment, e.g. while waiting for preempt_job() to take effect.
+void pause_kernel();
+
+// Returns the number of nanoseconds since the scheduler started.
+long long nsec_since_boot();
+
+// Stores job's resource usage in usage, including the time in its current state so far.
+void get_process_usage(pcb *job, proc_usage *usage);
+
+// Stores the 1, 5 and 15 minute load averages, i.e. the decaying average number of jobs that
+// are running or waiting to run, in out.
+void get_load_averages(double out[3]);
+
+// Brings the clock ticks (and the sleepers due by then) up to date, since the clock only
+// moves on its own when the timer goes off.
+void sync_clock_ticks();
 
 // Called from kernel in k_process_create(), added a newly created context in the sheduler queues.
 void add_job_to_scheduler(pcb *job);
@@ -41,7 +119,7 @@ void reset_active_job();
 // Frees all of the scheduler's resources.
 void free_scheduler_resources();
 
-// Calls sigsuspend to stop the current context.
+// Hands the CPU back to the scheduler, or waits for a signal if there's no active job.
 void suspend(void);
 
 // Initializes the scheduler's data structures.
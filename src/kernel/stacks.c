@@ -0,0 +1,188 @@
+// Definition of the allocator of context stacks.
+// Stacks are mapped with a guard page below them, so running off the end faults instead of
+// quietly overwriting whatever lies below. Sizes are rounded up to a power of two, and freed
+// stacks up to a megabyte are pooled by size, so spawning a process usually doesn't need to map
+// one. A pooled stack's pages are given back to the host, but it stays mapped, so it counts as
+// live stack memory.
+
+#include "stacks.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <valgrind/valgrind.h>
+
+#include "scheduler.h"
+#include "../lib/macros.h"
+#include "../lib/pcb.h"
+#include "../lib/tagged_alloc.h"
+
+// log2 of MIN_STACK_SIZE and MAX_STACK_SIZE.
+#define MIN_STACK_SHIFT 14
+#define MAX_STACK_SHIFT 26
+
+#define NUM_SIZE_CLASSES (MAX_STACK_SHIFT - MIN_STACK_SHIFT + 1)
+
+// log2 of the largest stack kept for reuse. Bigger ones are rare enough to map every time, and
+// would take up the pool on their own.
+#define MAX_POOLED_SHIFT 20
+
+#define NUM_POOLED_CLASSES (MAX_POOLED_SHIFT - MIN_STACK_SHIFT + 1)
+
+// Most stacks of one size class the pool can hold, which only the smallest class gets to.
+#define MAX_POOLED_STACKS (STACK_POOL_BYTES / MIN_STACK_SIZE)
+
+// Size of the stack the overflow handler runs on.
+#define ALT_STACK_SIZE (64 * 1024)
+
+// Freed stacks of each pooled size class, smallest class first, and their total size.
+static void *pool[NUM_POOLED_CLASSES][MAX_POOLED_STACKS];
+static int pool_size[NUM_POOLED_CLASSES];
+static size_t pool_bytes = 0;
+
+// Other cores spawn and reap processes too, and also allocate their own contexts' stacks
+// outside of any system call.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t page_size() {
+    static size_t size = 0;
+
+    if (size == 0) {
+        size = sysconf(_SC_PAGESIZE);
+    }
+
+    return size;
+}
+
+// Returns the size class of a stack of size bytes, i.e. the smallest power of two that fits it.
+static int size_class(size_t size) {
+    int class = 0;
+
+    while (class < NUM_SIZE_CLASSES - 1 && (size_t) 1 << (class + MIN_STACK_SHIFT) < size) {
+        class++;
+    }
+
+    return class;
+}
+
+void *alloc_stack(size_t size, size_t *actual_size) {
+    if (size > MAX_STACK_SIZE) {
+        return NULL;
+    }
+
+    int class = size_class(size);
+    size = (size_t) 1 << (class + MIN_STACK_SHIFT);
+    *actual_size = size;
+
+    void *stack = NULL;
+
+    if (class < NUM_POOLED_CLASSES) {
+        pthread_mutex_lock(&pool_lock);
+
+        if (pool_size[class] > 0) {
+            stack = pool[class][--pool_size[class]];
+            pool_bytes -= size;
+        }
+
+        pthread_mutex_unlock(&pool_lock);
+    }
+
+    if (stack != NULL) {
+        return stack;
+    }
+
+    // Anonymous memory is only committed once it's touched, so a stack costs what the process uses of it.
+    char *base = mmap(NULL, page_size() + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                      -1, 0);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (mprotect(base, page_size(), PROT_NONE) == -1) {
+        munmap(base, page_size() + size);
+        return NULL;
+    }
+
+    account_mapping(MEM_STACKS, page_size() + size);
+    stack = base + page_size();
+    VALGRIND_STACK_REGISTER(stack, stack + size);
+
+    return stack;
+}
+
+void free_stack(void *stack, size_t size) {
+    int class = size_class(size);
+
+    if (class < NUM_POOLED_CLASSES) {
+        // Whatever the process touched would otherwise stay committed for as long as the stack is
+        // pooled. The next process to get it starts from zeroed pages again.
+        madvise(stack, size, MADV_DONTNEED);
+
+        pthread_mutex_lock(&pool_lock);
+
+        if (pool_bytes + size <= STACK_POOL_BYTES) {
+            pool[class][pool_size[class]++] = stack;
+            pool_bytes += size;
+            stack = NULL;
+        }
+
+        pthread_mutex_unlock(&pool_lock);
+    }
+
+    if (stack != NULL) {
+        munmap((char *) stack - page_size(), page_size() + size);
+        account_mapping(MEM_STACKS, -(long long) (page_size() + size));
+    }
+}
+
+void free_stack_pool() {
+    pthread_mutex_lock(&pool_lock);
+
+    for (int class = 0; class < NUM_POOLED_CLASSES; class++) {
+        size_t size = (size_t) 1 << (class + MIN_STACK_SHIFT);
+
+        while (pool_size[class] > 0) {
+            munmap((char *) pool[class][--pool_size[class]] - page_size(), page_size() + size);
+            account_mapping(MEM_STACKS, -(long long) (page_size() + size));
+        }
+    }
+
+    pool_bytes = 0;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Signal handler for SIGSEGV, which runs on its own stack, since the one that overflowed is full.
+static void overflow_handler(int signum, siginfo_t *info, void *uc) {
+    pcb *job = get_active_job();
+    char *addr = info->si_addr;
+
+    if (job != NULL && job->context != NULL) {
+        char *stack = job->context->uc_stack.ss_sp;
+
+        if (addr >= stack - page_size() && addr < stack) {
+            char msg[256];
+            int len = snprintf(msg, sizeof(msg), "pennos: process %d (%s) overflowed its %zu-byte stack\n", job->pid,
+                               job->cmd, job->context->uc_stack.ss_size);
+            write(STDERR_FILENO, msg, MIN(len, (int) sizeof(msg) - 1));
+        }
+    }
+
+    // The faulting instruction runs again once this returns, and crashes PennOS like any other fault.
+    signal(SIGSEGV, SIG_DFL);
+}
+
+void init_stack_overflow_handler() {
+    stack_t alt_stack = {.ss_sp = tagged_malloc(MEM_STACKS, ALT_STACK_SIZE), .ss_size = ALT_STACK_SIZE, .ss_flags = 0};
+    HANDLE_SYS_CALL(alt_stack.ss_sp == NULL || sigaltstack(&alt_stack, NULL) == -1,
+                    "Error setting up the overflow handler's stack.");
+
+    struct sigaction act;
+    act.sa_sigaction = overflow_handler;
+    act.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigfillset(&act.sa_mask);
+    sigaction(SIGSEGV, &act, NULL);
+}
@@ -0,0 +1,33 @@
+// Declaration of the allocator of context stacks.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Stack size of a process unless p_spawn_with_stack() asks for another.
+#define DEFAULT_STACK_SIZE (128 * 1024)
+
+// Smallest and largest stack a process can have. The smallest still fits the signal frames the
+// scheduler's timer pushes.
+#define MIN_STACK_SIZE (16 * 1024)
+#define MAX_STACK_SIZE (64 * 1024 * 1024)
+
+// Most bytes of freed stacks kept for reuse, of all sizes together. Their pages are given back to
+// the host when they're freed, so this only bounds the address space the pool holds on to.
+#define STACK_POOL_BYTES (32 * 1024 * 1024)
+
+// Returns the lowest usable address of a stack of at least size bytes (at most MAX_STACK_SIZE),
+// and stores its actual size in actual_size. The stack has an inaccessible guard page below it,
+// and its memory is only committed as it's touched. Returns NULL if it can't be mapped.
+void *alloc_stack(size_t size, size_t *actual_size);
+
+// Gives back a stack returned by alloc_stack(), which is kept for reuse if there's room.
+void free_stack(void *stack, size_t size);
+
+// Unmaps every stack kept for reuse.
+void free_stack_pool();
+
+// Makes the calling host thread report a process overflowing its stack before it crashes.
+// Every host thread that runs processes has to call this.
+void init_stack_overflow_handler();
@@ -0,0 +1,213 @@
+// Definition of the system call statistics.
+// With one core, a process can be preempted anywhere in a system call, so the global counters
+// are updated atomically. A process's own counters are only updated by the process itself.
+
+#ifdef SYSSTAT
+
+#include "syscall_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pcb_table.h"
+#include "scheduler.h"
+#include "../lib/errno.h"
+#include "../lib/pcb.h"
+#include "../lib/tagged_alloc.h"
+
+// Number of errno_st values.
+#define NUM_ERRNOS (NO_MORE_SPACE + 1)
+
+// Names of the errno_st values, in the order they're declared.
+static const char *errno_names[NUM_ERRNOS] = {
+        "NOERROR", "NOCHILDCREATED", "ACTIVEJOBNULL", "NOTINPCBTABLE", "KILLZOMBIE", "NOSUCHCHILD",
+        "NOTFOUNDINSCHEDULER", "INVALIDPRIORITY", "INVALIDSIGNAL", "INVALIDWEIGHT", "INVALIDSTACKSIZE",
+        "INVALID_WHENCE", "INVALID_OFFSET", "FILE_NOT_FOUND", "UNALLOCATED_BLOCK", "PERMISSION_DENIED",
+        "BROKEN_PIPE", "NOT_A_FILE", "SAME_PIPE", "INVALID_MODE", "INVALID_FILE_NAME",
+        "INVALID_FILE_NAME_POSIX", "ATTEMPTED_DOUBLE_WRITE", "READ_FILE_NOT_FOUND", "CLOSE_UNOPEN_FILE", "DOUBLE_DELETION",
+        "FILE_NOT_FOUND_OFT", "TOO_MANY_OPEN_FILES", "NO_MORE_SPACE"};
+
+// Names of the system calls, indexed by their ids, and how many there are.
+static const char *names[MAX_SYSCALLS];
+static int num_syscalls = 0;
+
+static syscall_usage totals[MAX_SYSCALLS];
+static unsigned long errors_by_errno[MAX_SYSCALLS][NUM_ERRNOS];
+
+static long long monotonic_nsec() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Values of a system call's id before it's assigned an index.
+#define ID_UNASSIGNED -1
+#define ID_ASSIGNING -2
+#define ID_NOT_COUNTED -3
+
+// Returns the id of the system call called name, assigning it one on its first call. Returns -1
+// if it isn't counted, if there's no room for it, or if another process is assigning it one at
+// the same time.
+static int syscall_id(int *id, const char *name) {
+    int current = __atomic_load_n(id, __ATOMIC_ACQUIRE);
+
+    if (current != ID_UNASSIGNED) {
+        return current < 0 ? -1 : current;
+    }
+
+    // Only the p_* and f_* API is counted, not the other code that runs in the kernel, like ps.
+    if (strncmp(name, "p_", 2) != 0 && strncmp(name, "f_", 2) != 0) {
+        __atomic_store_n(id, ID_NOT_COUNTED, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    if (!__atomic_compare_exchange_n(id, &current, ID_ASSIGNING, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return current < 0 ? -1 : current;
+    }
+
+    int new_id = __atomic_fetch_add(&num_syscalls, 1, __ATOMIC_ACQ_REL);
+
+    if (new_id >= MAX_SYSCALLS) {
+        __atomic_store_n(&num_syscalls, MAX_SYSCALLS, __ATOMIC_RELEASE);
+        __atomic_store_n(id, ID_NOT_COUNTED, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    names[new_id] = name;
+    __atomic_store_n(id, new_id, __ATOMIC_RELEASE);
+    return new_id;
+}
+
+// Adds a call that took nsec to usage. Atomic for the global counters.
+static void add_call(syscall_usage *usage, long long nsec, bool error) {
+    __atomic_add_fetch(&usage->total_nsec, nsec, __ATOMIC_RELAXED);
+
+    if (error) {
+        __atomic_add_fetch(&usage->errors, 1, __ATOMIC_RELAXED);
+    }
+
+    long long max = __atomic_load_n(&usage->max_nsec, __ATOMIC_RELAXED);
+
+    while (nsec > max && !__atomic_compare_exchange_n(&usage->max_nsec, &max, nsec, true, __ATOMIC_RELAXED,
+                                                      __ATOMIC_RELAXED));
+}
+
+syscall_frame enter_syscall(int *id, const char *name) {
+    enter_kernel();
+
+    syscall_frame frame = {.id = syscall_id(id, name), .start_nsec = 0, .errors_set = 0};
+
+    if (frame.id == -1) {
+        return frame;
+    }
+
+    __atomic_add_fetch(&totals[frame.id].calls, 1, __ATOMIC_RELAXED);
+    pcb *job = get_active_job();
+
+    if (job != NULL) {
+        // A process's counters are allocated on its first system call.
+        if (job->syscalls == NULL) {
+            job->syscalls = (syscall_usage *) tagged_calloc(MEM_PROFILING, MAX_SYSCALLS, sizeof(syscall_usage));
+        }
+
+        if (job->syscalls != NULL) {
+            job->syscalls[frame.id].calls++;
+        }
+
+        frame.errors_set = job->errors_set;
+    }
+
+    frame.start_nsec = monotonic_nsec();
+    return frame;
+}
+
+void exit_syscall(syscall_frame *frame) {
+    if (frame->id != -1) {
+        long long nsec = monotonic_nsec() - frame->start_nsec;
+        pcb *job = get_active_job();
+        bool error = job != NULL && job->errors_set != frame->errors_set && job->error != NOERROR;
+
+        add_call(&totals[frame->id], nsec, error);
+
+        if (error) {
+            __atomic_add_fetch(&errors_by_errno[frame->id][job->error], 1, __ATOMIC_RELAXED);
+        }
+
+        if (job != NULL && job->syscalls != NULL) {
+            add_call(&job->syscalls[frame->id], nsec, error);
+        }
+    }
+
+    exit_kernel(NULL);
+}
+
+// Prints a table of the system calls in usage that were called.
+static void print_usage_table(FILE *out, syscall_usage *usage) {
+    fprintf(out, "%-24s %9s %7s %12s %10s %10s\n", "SYSCALL", "CALLS", "ERRORS", "TOTAL_US", "AVG_NS", "MAX_NS");
+
+    for (int i = 0; i < num_syscalls; i++) {
+        if (usage[i].calls > 0) {
+            fprintf(out, "%-24s %9lu %7lu %12lld %10lld %10lld\n", names[i], usage[i].calls, usage[i].errors,
+                    usage[i].total_nsec / 1000, usage[i].total_nsec / (long long) usage[i].calls,
+                    usage[i].max_nsec);
+        }
+    }
+}
+
+int print_syscall_stats(FILE *out, pid_t pid) {
+    if (pid != -1) {
+        pcb *proc = find_pcb_in_table(pid);
+
+        if (proc == NULL) {
+            return -1;
+        }
+
+        fprintf(out, "System calls of process %d (%s)\n", pid, proc->cmd);
+
+        if (proc->syscalls != NULL) {
+            print_usage_table(out, proc->syscalls);
+        }
+
+        return 0;
+    }
+
+    fprintf(out, "System calls of every process\n");
+    print_usage_table(out, totals);
+
+    bool header = false;
+
+    for (int i = 0; i < num_syscalls; i++) {
+        for (int j = 0; j < NUM_ERRNOS; j++) {
+            if (errors_by_errno[i][j] == 0) {
+                continue;
+            }
+
+            if (!header) {
+                fprintf(out, "\n%-24s %-24s %7s\n", "SYSCALL", "ERROR", "COUNT");
+                header = true;
+            }
+
+            fprintf(out, "%-24s %-24s %7lu\n", names[i], errno_names[j], errors_by_errno[i][j]);
+        }
+    }
+
+    fprintf(out, "\n%4s %9s %7s %12s  %s\n", "PID", "CALLS", "ERRORS", "TOTAL_US", "CMD");
+
+    for (pcb *proc = next_pcb_in_table(0); proc != NULL; proc = next_pcb_in_table(proc->pid)) {
+        syscall_usage sum = {0};
+
+        for (int i = 0; proc->syscalls != NULL && i < num_syscalls; i++) {
+            sum.calls += proc->syscalls[i].calls;
+            sum.errors += proc->syscalls[i].errors;
+            sum.total_nsec += proc->syscalls[i].total_nsec;
+        }
+
+        fprintf(out, "%4d %9lu %7lu %12lld  %s\n", proc->pid, sum.calls, sum.errors, sum.total_nsec / 1000,
+                proc->cmd);
+    }
+
+    return 0;
+}
+
+#endif
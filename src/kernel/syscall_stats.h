@@ -0,0 +1,50 @@
+// Declaration of the system call statistics, which count every system call, how long it took and
+// how it failed, globally and per process. They're only compiled in with -DSYSSTAT, see
+// SYSTEM_CALL().
+
+#pragma once
+
+#ifdef SYSSTAT
+
+#include <stdio.h>
+#include <sys/types.h>
+
+// Most distinct system calls that are counted. Any past these aren't.
+#define MAX_SYSCALLS 128
+
+// Count and latency of one system call, globally or for one process.
+typedef struct syscall_usage_st {
+    unsigned long calls;
+    unsigned long errors;
+
+    // Time from entering the system call to returning from it, on the host's monotonic clock.
+    // System calls that don't return, like p_exit, only add to calls.
+    long long total_nsec;
+    long long max_nsec;
+} syscall_usage;
+
+// A system call in progress, from enter_syscall() until exit_syscall().
+typedef struct syscall_frame_st {
+    // Index of the system call, or -1 if it isn't counted.
+    int id;
+
+    long long start_nsec;
+
+    // The calling process's errors_set when it entered, to tell whether the call set an error.
+    unsigned long errors_set;
+} syscall_frame;
+
+// Enters the kernel like enter_kernel() and starts timing the system call called name. id is
+// the call's index, which is assigned on its first call and is -1 until then.
+syscall_frame enter_syscall(int *id, const char *name);
+
+// Counts the system call of frame, then exits the kernel like exit_kernel().
+void exit_syscall(syscall_frame *frame);
+
+// Prints the count, errors and latency of every system call made, and the errors of each by
+// errno_st, to out. If pid isn't -1, prints those of the process with the pid instead, or
+// returns -1 if there's none. Returns 0 otherwise. Has to be called in a system call, or once the
+// cores stopped.
+int print_syscall_stats(FILE *out, pid_t pid);
+
+#endif
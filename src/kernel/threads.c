@@ -1,91 +1,220 @@
 // Definitions of functions for creating and managing ucontexts.
 // Contains special ucontext pointers.
 
+// The register names in ucontext_t need the GNU extensions.
+#define _GNU_SOURCE
+
 #include "threads.h"
 
 #include <stddef.h>
 #include <signal.h>
-#include <valgrind/valgrind.h>
 
 #include "scheduler.h"
+#include "stacks.h"
+#include "../lib/tagged_alloc.h"
 #include "../shell/shell.h"
 
-// Main context for OS.
-static ucontext_t os_context;
+// Main context of each core's host thread. Core 0's is the OS's main context.
+static ucontext_t os_contexts[MAX_CORES];
 
-// Context containing the scheduler function.
-static ucontext_t *scheduler_context;
+// Context containing the scheduler function, one per core.
+static ucontext_t *scheduler_contexts[MAX_CORES];
 
-// Context for when all 3 priority queues are empty.
-static ucontext_t *idle_context;
+// Context for when all 3 priority queues are empty, one per core.
+static ucontext_t *idle_contexts[MAX_CORES];
 
 // Shell when all 3 priority queues are empty.
 static ucontext_t *shell_context;
 
-void set_stack(stack_t *stack) {
-    int stacksize = 131072;
-    void *sp = malloc(stacksize);
-    VALGRIND_STACK_REGISTER(sp, sp + stacksize);
+#if FAST_SWITCH
+
+// Offsets in ucontext_t of the registers the fast switch saves and loads. They're the same
+// slots swapcontext() uses, so a context can be saved by one and resumed by the other, and
+// makecontext() sets up new contexts for both.
+#define UC_GREG(reg) (offsetof(ucontext_t, uc_mcontext.gregs) + (reg) * sizeof(greg_t))
+#define UC_FPU_CW offsetof(ucontext_t, __fpregs_mem.cwd)
+#define UC_MXCSR offsetof(ucontext_t, __fpregs_mem.mxcsr)
+
+_Static_assert(UC_GREG(REG_R8) == 40 && UC_GREG(REG_R9) == 48 && UC_GREG(REG_R12) == 72 &&
+               UC_GREG(REG_R13) == 80 && UC_GREG(REG_R14) == 88 && UC_GREG(REG_R15) == 96 &&
+               UC_GREG(REG_RDI) == 104 && UC_GREG(REG_RSI) == 112 && UC_GREG(REG_RBP) == 120 &&
+               UC_GREG(REG_RBX) == 128 && UC_GREG(REG_RDX) == 136 && UC_GREG(REG_RCX) == 152 &&
+               UC_GREG(REG_RSP) == 160 && UC_GREG(REG_RIP) == 168 && UC_FPU_CW == 424 && UC_MXCSR == 448,
+               "ucontext_t layout doesn't match the fast context switch");
+
+// Only the registers a function call has to preserve are saved, plus the stack pointer and the
+// return address. Loading a context also loads the argument registers, which makecontext() fills in.
+__asm__(".text\n"
+        ".globl fast_swap_context\n"
+        ".hidden fast_swap_context\n"
+        ".type fast_swap_context, @function\n"
+        "fast_swap_context:\n"
+        "    movq %rbx, 128(%rdi)\n"
+        "    movq %rbp, 120(%rdi)\n"
+        "    movq %r12, 72(%rdi)\n"
+        "    movq %r13, 80(%rdi)\n"
+        "    movq %r14, 88(%rdi)\n"
+        "    movq %r15, 96(%rdi)\n"
+        "    fnstcw 424(%rdi)\n"
+        "    stmxcsr 448(%rdi)\n"
+        "    movq (%rsp), %rcx\n"
+        "    movq %rcx, 168(%rdi)\n"
+        "    leaq 8(%rsp), %rcx\n"
+        "    movq %rcx, 160(%rdi)\n"
+        "    movq %rsi, %rdi\n"
+        ".globl fast_set_context\n"
+        ".hidden fast_set_context\n"
+        ".type fast_set_context, @function\n"
+        "fast_set_context:\n"
+        "    movq 160(%rdi), %rsp\n"
+        "    movq 128(%rdi), %rbx\n"
+        "    movq 120(%rdi), %rbp\n"
+        "    movq 72(%rdi), %r12\n"
+        "    movq 80(%rdi), %r13\n"
+        "    movq 88(%rdi), %r14\n"
+        "    movq 96(%rdi), %r15\n"
+        "    fldcw 424(%rdi)\n"
+        "    ldmxcsr 448(%rdi)\n"
+        "    movq 112(%rdi), %rsi\n"
+        "    movq 136(%rdi), %rdx\n"
+        "    movq 152(%rdi), %rcx\n"
+        "    movq 40(%rdi), %r8\n"
+        "    movq 48(%rdi), %r9\n"
+        "    pushq 168(%rdi)\n"
+        "    movq 104(%rdi), %rdi\n"
+        "    ret\n");
+
+void fast_set_context(ucontext_t *ucp);
+
+#else
+
+void fast_swap_context(ucontext_t *from, ucontext_t *to) {
+    swapcontext(from, to);
+}
+
+#endif
+
+bool fast_switch_available() {
+    return FAST_SWITCH;
+}
+
+void switch_context(ucontext_t *from, ucontext_t *to) {
+#if FAST_SWITCH
+    fast_swap_context(from, to);
+#else
+    swapcontext(from, to);
+#endif
+}
+
+void resume_context(ucontext_t *ucp) {
+#if FAST_SWITCH
+    fast_set_context(ucp);
+#else
+    setcontext(ucp);
+#endif
+}
+
+// Gives stack a freshly allocated stack of at least size bytes. Returns false if there's no memory for it.
+bool set_stack(stack_t *stack, size_t size) {
+    size_t stacksize;
+    void *sp = alloc_stack(size, &stacksize);
 
     *stack = (stack_t) {.ss_sp = sp, .ss_size = stacksize};
+    return sp != NULL;
 }
 
-void configure_scheduler_context() {
+void configure_scheduler_context(ucontext_t *scheduler_context) {
     getcontext(scheduler_context);
     sigemptyset(&scheduler_context->uc_sigmask);
 
-    // Block the alarm signal in the scheduler.
+    // Block the alarm signal in the scheduler, and the terminal signals, whose handlers
+    // assume they interrupt a process.
     sigaddset(&scheduler_context->uc_sigmask, SIGALRM);
+    sigaddset(&scheduler_context->uc_sigmask, SIGINT);
+    sigaddset(&scheduler_context->uc_sigmask, SIGTSTP);
 
-    set_stack(&scheduler_context->uc_stack);
+    HANDLE_SYS_CALL(!set_stack(&scheduler_context->uc_stack, DEFAULT_STACK_SIZE), "Error allocating a stack.");
     scheduler_context->uc_link = NULL;
     makecontext(scheduler_context, scheduler, 0);
 }
 
-void init_threads() {
-    scheduler_context = (ucontext_t *) malloc(sizeof(ucontext_t));
-    configure_scheduler_context();
+void init_core_contexts(int core) {
+    init_stack_overflow_handler();
 
-    idle_context = (ucontext_t *) malloc(sizeof(ucontext_t));
-    make_context(idle_context, suspend, NULL);
+    scheduler_contexts[core] = (ucontext_t *) tagged_malloc(MEM_CONTEXTS, sizeof(ucontext_t));
+    configure_scheduler_context(scheduler_contexts[core]);
 
-    shell_context = (ucontext_t *) malloc(sizeof(ucontext_t));
-    make_context(shell_context, main_shell, NULL);
+    idle_contexts[core] = (ucontext_t *) tagged_malloc(MEM_CONTEXTS, sizeof(ucontext_t));
+    HANDLE_SYS_CALL(!make_context(idle_contexts[core], suspend, NULL, DEFAULT_STACK_SIZE),
+                    "Error allocating a stack.");
 }
 
-void start_scheduler_thread() {
-    swapcontext(&os_context, scheduler_context);
+void init_threads() {
+    init_core_contexts(0);
+
+    shell_context = (ucontext_t *) tagged_malloc(MEM_CONTEXTS, sizeof(ucontext_t));
+    HANDLE_SYS_CALL(!make_context(shell_context, main_shell, NULL, DEFAULT_STACK_SIZE), "Error allocating a stack.");
 }
 
-void make_context(ucontext_t *ucp, void (*func)(), char **func_and_arg) {
-    getcontext(ucp);
-    sigemptyset(&ucp->uc_sigmask);
+void start_scheduler_thread() {
+    switch_context(get_os_context(), get_scheduler_context());
+}
 
-    set_stack(&ucp->uc_stack);
-    ucp->uc_link = scheduler_context;
+// Runs func in a context made by make_context. Once it returns, the context goes back to the
+// scheduler of whichever core it's on by then, which uc_link can't follow.
+static void run_context(void (*func)(), char **func_and_arg) {
+#if FAST_SWITCH
+    // The fast switch leaves the signal mask alone, so the context starts with the scheduler's.
+    sigset_t empty_set;
+    sigemptyset(&empty_set);
+    sigprocmask(SIG_SETMASK, &empty_set, NULL);
+#endif
 
     if (func_and_arg == NULL) {
-        makecontext(ucp, func, 0);
+        func();
     } else {
-        makecontext(ucp, func, 1, func_and_arg);
+        func(func_and_arg);
+    }
+
+#if FAST_SWITCH
+    sigprocmask(SIG_SETMASK, &get_scheduler_context()->uc_sigmask, NULL);
+#endif
+
+    resume_context(get_scheduler_context());
+}
+
+bool make_context(ucontext_t *ucp, void (*func)(), char **func_and_arg, size_t stack_size) {
+    getcontext(ucp);
+    sigemptyset(&ucp->uc_sigmask);
+
+    if (!set_stack(&ucp->uc_stack, stack_size)) {
+        return false;
     }
+
+    ucp->uc_link = NULL;
+
+    makecontext(ucp, (void (*)()) run_context, 2, func, func_and_arg);
+    return true;
 }
 
 void free_context(ucontext_t *ucp) {
-    free(ucp->uc_stack.ss_sp);
-    free(ucp);
+    if (ucp->uc_stack.ss_sp != NULL) {
+        free_stack(ucp->uc_stack.ss_sp, ucp->uc_stack.ss_size);
+    }
+
+    tagged_free(ucp);
 }
 
 ucontext_t *get_os_context() {
-    return &os_context;
+    return &os_contexts[current_core_id()];
 }
 
 ucontext_t *get_scheduler_context() {
-    return scheduler_context;
+    return scheduler_contexts[current_core_id()];
 }
 
 ucontext_t *get_idle_context() {
-    return idle_context;
+    return idle_contexts[current_core_id()];
 }
 
 ucontext_t *get_shell_context() {
@@ -93,14 +222,19 @@ ucontext_t *get_shell_context() {
 }
 
 void set_scheduler_uc_link(ucontext_t *ucp) {
-    scheduler_context->uc_link = ucp;
+    scheduler_contexts[current_core_id()]->uc_link = ucp;
 }
 
 void free_init_contexts() {
-    free_context(scheduler_context);
-    free_context(idle_context);
+    for (int i = 0; i < MAX_CORES; i++) {
+        if (scheduler_contexts[i] != NULL) {
+            free_context(scheduler_contexts[i]);
+            free_context(idle_contexts[i]);
+        }
+
+        scheduler_contexts[i] = NULL;
+        idle_contexts[i] = NULL;
+    }
 
-    scheduler_context = NULL;
-    idle_context = NULL;
     shell_context = NULL;
-}
\ No newline at end of file
+}
@@ -2,31 +2,61 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <ucontext.h>
 
+// Contexts are switched by a short assembly routine on x86-64 with glibc, unless built with
+// -DNO_FAST_SWITCH. swapcontext() and setcontext() are used elsewhere.
+#if defined(__x86_64__) && defined(__GLIBC__) && !defined(NO_FAST_SWITCH)
+#define FAST_SWITCH 1
+#else
+#define FAST_SWITCH 0
+#endif
+
+// Makes core 0's contexts and the shell's.
 void init_threads();
 
+// Makes the scheduler and idle contexts of the given core.
+void init_core_contexts(int core);
+
+// Runs the scheduler on the calling core until it shuts down.
 void start_scheduler_thread();
 
 // Makes the context given a u_context pointer, calles getcontext(), sets stack, link, etc.
-void make_context(ucontext_t *ucp, void (*func)(), char **func_and_arg);
+// The stack is at least stack_size bytes. Returns false if it couldn't be allocated.
+bool make_context(ucontext_t *ucp, void (*func)(), char **func_and_arg, size_t stack_size);
+
+// Saves the current context in from and switches to to, like swapcontext(). The fast switch
+// leaves the signal mask as it is, so a switch to the scheduler has to block its signals first.
+void switch_context(ucontext_t *from, ucontext_t *to);
+
+// Switches to ucp, like setcontext(), with the same caveat as switch_context().
+void resume_context(ucontext_t *ucp);
+
+// Returns whether contexts are switched by the fast switch.
+bool fast_switch_available();
+
+// The fast switch, for benchmarking it against swapcontext(). It's swapcontext() itself where
+// the fast switch isn't available.
+void fast_swap_context(ucontext_t *from, ucontext_t *to);
 
 // Frees ucontext.
 void free_context(ucontext_t *ucp);
 
-// Returns a pointer to the main OS context.
+// Returns a pointer to the main context of the calling core, i.e. the OS's on core 0.
 ucontext_t *get_os_context();
 
-// Returns a pointer to the scheduler context.
+// Returns a pointer to the calling core's scheduler context.
 ucontext_t *get_scheduler_context();
 
-// Returns a pointer to the idle context.
+// Returns a pointer to the calling core's idle context.
 ucontext_t *get_idle_context();
 
 // Returns a pointer to the idle context.
 ucontext_t *get_shell_context();
 
-// Sets the UC link for the scheduler context.
+// Sets the UC link for the calling core's scheduler context.
 void set_scheduler_uc_link(ucontext_t *ucp);
 
 // Free the initialized contexts.
@@ -0,0 +1,182 @@
+// Definition of the timer wheel holding sleeping processes.
+// Jobs are linked into the slots through their timer_prev and timer_next fields, so
+// setting and cancelling an alarm is O(1) and doesn't allocate.
+
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#include "../lib/log.h"
+
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+// Furthest a job can be filed ahead of the wheel. Jobs due later are filed this far ahead,
+// and get filed again (closer to when they're due) as the wheel turns.
+#define WHEEL_MAX_DELTA ((1u << (WHEEL_LEVELS * WHEEL_BITS)) - 1)
+
+// The slots of every level, level 0 first. Each slot is the head of a list of jobs.
+static pcb *slots[WHEEL_LEVELS * WHEEL_SIZE];
+
+// The last clock tick the wheel has been turned to.
+static unsigned int wheel_tick;
+
+static int num_sleeping;
+
+// Files job into the slot for its wake tick, relative to where the wheel is.
+// Jobs that are already due go into the slot of the current tick.
+static void file_job(pcb *job) {
+    int delta = (int) (job->wake_tick - wheel_tick);
+
+    if (delta < 0) {
+        delta = 0;
+    } else if ((unsigned int) delta > WHEEL_MAX_DELTA) {
+        delta = WHEEL_MAX_DELTA;
+    }
+
+    unsigned int expires = wheel_tick + delta;
+    int level = 0;
+
+    while (level < WHEEL_LEVELS - 1 && (unsigned int) delta >= 1u << ((level + 1) * WHEEL_BITS)) {
+        level++;
+    }
+
+    int slot = level * WHEEL_SIZE + ((expires >> (level * WHEEL_BITS)) & WHEEL_MASK);
+
+    job->timer_prev = NULL;
+    job->timer_next = slots[slot];
+
+    if (slots[slot] != NULL) {
+        slots[slot]->timer_prev = job;
+    }
+
+    slots[slot] = job;
+    job->timer_slot = slot;
+}
+
+// Unlinks job from its slot.
+static void unfile_job(pcb *job) {
+    if (job->timer_prev != NULL) {
+        job->timer_prev->timer_next = job->timer_next;
+    } else {
+        slots[job->timer_slot] = job->timer_next;
+    }
+
+    if (job->timer_next != NULL) {
+        job->timer_next->timer_prev = job->timer_prev;
+    }
+
+    job->timer_prev = NULL;
+    job->timer_next = NULL;
+    job->timer_slot = NOT_SLEEPING;
+}
+
+// Files every job in slot again, which moves them down a level now that they're closer to being due.
+static void cascade(int slot) {
+    pcb *job = slots[slot];
+    slots[slot] = NULL;
+
+    while (job != NULL) {
+        pcb *next = job->timer_next;
+        file_job(job);
+        job = next;
+    }
+}
+
+void init_sleep_queue() {
+    memset(slots, 0, sizeof(slots));
+    wheel_tick = get_clock_ticks();
+    num_sleeping = 0;
+}
+
+void set_sleep_alarm(unsigned int ticks, pcb *job) {
+    cancel_sleep_alarm(job);
+
+    // The current tick has already gone by, so the soonest a job can wake is the next one.
+    job->wake_tick = get_clock_ticks() + (ticks == 0 ? 1 : ticks);
+    file_job(job);
+    num_sleeping++;
+}
+
+void cancel_sleep_alarm(pcb *job) {
+    if (job->timer_slot == NOT_SLEEPING) {
+        return;
+    }
+
+    unfile_job(job);
+    num_sleeping--;
+}
+
+void expire_sleep_alarms(unsigned int now, void (*wake)(pcb *)) {
+    while (wheel_tick != now) {
+        unsigned int next_tick = wheel_tick + 1;
+
+        // Nothing goes off or cascades before the next alarm, so over long stretches the wheel
+        // can skip straight to it. Over short ones, turning it tick by tick is cheaper than the search.
+        if (num_sleeping == 0 || (now - wheel_tick > WHEEL_SIZE && next_sleep_alarm(&next_tick) &&
+                                  (int) (next_tick - now) > 0)) {
+            wheel_tick = now;
+            return;
+        }
+
+        wheel_tick = next_tick;
+
+        // Once the slots of a level have all gone by, the next slot of the level above is split among them.
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (((wheel_tick >> ((level - 1) * WHEEL_BITS)) & WHEEL_MASK) != 0) {
+                break;
+            }
+
+            cascade(level * WHEEL_SIZE + ((wheel_tick >> (level * WHEEL_BITS)) & WHEEL_MASK));
+        }
+
+        pcb *job = slots[wheel_tick & WHEEL_MASK];
+
+        while (job != NULL) {
+            pcb *next = job->timer_next;
+            unfile_job(job);
+
+            if ((int) (job->wake_tick - wheel_tick) > 0) {
+                // Was filed early because it's due further ahead than the wheel reaches.
+                file_job(job);
+            } else {
+                num_sleeping--;
+                wake(job);
+            }
+
+            job = next;
+        }
+    }
+}
+
+bool next_sleep_alarm(unsigned int *tick) {
+    if (num_sleeping == 0) {
+        return false;
+    }
+
+    bool found = false;
+
+    // The first non-empty slot of each level, looking ahead from where the wheel is.
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = level * WHEEL_BITS;
+
+        for (unsigned int i = 1; i <= WHEEL_SIZE; i++) {
+            // The tick at which the slot i slots ahead comes up.
+            unsigned int slot_tick = ((wheel_tick >> shift) + i) << shift;
+
+            if (slots[level * WHEEL_SIZE + ((slot_tick >> shift) & WHEEL_MASK)] != NULL) {
+                if (!found || (int) (slot_tick - *tick) < 0) {
+                    *tick = slot_tick;
+                    found = true;
+                }
+
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+int num_sleeping_jobs() {
+    return num_sleeping;
+}
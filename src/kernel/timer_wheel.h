@@ -0,0 +1,31 @@
+// Declaration of the timer wheel holding sleeping processes.
+
+#pragma once
+
+#include "../lib/pcb.h"
+
+// Each level of the wheel has 2^WHEEL_BITS slots, and each slot of a level spans all the
+// slots of the level below it. Level 0 slots are one tick each.
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+
+// Initializes the empty sleep queue. The wheel starts at the current clock tick.
+void init_sleep_queue();
+
+// Registers the sleeping job with the sleep handler. It's due ticks clock ticks from now.
+void set_sleep_alarm(unsigned int ticks, pcb *job);
+
+// Removes job from the sleep queue, if it's sleeping.
+void cancel_sleep_alarm(pcb *job);
+
+// Turns the wheel up to clock tick now, calling wake on every job whose sleep is due,
+// in the order they're due.
+void expire_sleep_alarms(unsigned int now, void (*wake)(pcb *));
+
+// Stores in tick the next clock tick the wheel has to be turned to, i.e. when the next sleeper
+// is due or a slot holding sleepers has to be cascaded. Returns false if no job is sleeping.
+bool next_sleep_alarm(unsigned int *tick);
+
+// Returns the number of sleeping jobs.
+int num_sleeping_jobs();
@@ -0,0 +1,99 @@
+// Definition of wait queues. Like the scheduler queues and the timer wheel, they link the
+// processes themselves, so waiting and waking up is O(1) and doesn't allocate.
+
+#include "wait_queue.h"
+
+#include "scheduler.h"
+#include "../lib/log.h"
+
+void init_wait_queue(wait_queue *queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+// Unlinks job from the queue it's waiting on.
+static void unlink_waiter(pcb *job) {
+    wait_queue *queue = job->wait_queue;
+
+    if (job->wait_prev != NULL) {
+        job->wait_prev->wait_next = job->wait_next;
+    } else {
+        queue->head = job->wait_next;
+    }
+
+    if (job->wait_next != NULL) {
+        job->wait_next->wait_prev = job->wait_prev;
+    } else {
+        queue->tail = job->wait_prev;
+    }
+
+    job->wait_prev = NULL;
+    job->wait_next = NULL;
+    job->wait_queue = NULL;
+}
+
+void wait_on(wait_queue *queue) {
+    pcb *job = get_active_job();
+
+    if (job == NULL) {
+        set_errno(ACTIVEJOBNULL);
+        return;
+    }
+
+    job->wait_prev = queue->tail;
+    job->wait_next = NULL;
+    job->wait_queue = queue;
+
+    if (queue->tail != NULL) {
+        queue->tail->wait_next = job;
+    } else {
+        queue->head = job;
+    }
+
+    queue->tail = job;
+    job->blocked = true;
+
+    // Logging.
+    log_event(BLOCKED_EVT, job);
+
+    suspend();
+
+    // Whoever woke the job up normally took it off the queue already.
+    if (job->wait_queue != NULL) {
+        unlink_waiter(job);
+    }
+}
+
+// Wakes up job. A stopped job is only put back in the scheduler queues once it's continued.
+static void wake_up(pcb *job) {
+    unlink_waiter(job);
+    job->blocked = false;
+
+    // Logging.
+    log_event(UNBLOCKED_EVT, job);
+
+    if (job->status == RUNNING) {
+        add_job_to_scheduler(job);
+    }
+}
+
+bool wake_up_one(wait_queue *queue) {
+    if (queue->head == NULL) {
+        return false;
+    }
+
+    wake_up(queue->head);
+    return true;
+}
+
+void wake_up_all(wait_queue *queue) {
+    while (queue->head != NULL) {
+        wake_up(queue->head);
+    }
+}
+
+void cancel_wait(pcb *job) {
+    if (job->wait_queue != NULL) {
+        unlink_waiter(job);
+    }
+}
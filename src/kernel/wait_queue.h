@@ -0,0 +1,31 @@
+// Declaration of wait queues, on which processes block until an event wakes them up.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "../lib/pcb.h"
+
+// Processes waiting for the same event, in the order they started waiting. They're linked
+// through their wait_prev and wait_next fields.
+typedef struct wait_queue_st {
+    pcb *head;
+    pcb *tail;
+} wait_queue;
+
+// Initializes an empty wait queue.
+void init_wait_queue(wait_queue *queue);
+
+// Blocks the active process on queue until it's woken up. It may be woken up for an event
+// that's already been consumed, so the caller has to check for what it's waiting for again.
+// Has to be called in a system call.
+void wait_on(wait_queue *queue);
+
+// Wakes up the process that's waited the longest on queue. Returns false if none was waiting.
+bool wake_up_one(wait_queue *queue);
+
+// Wakes up every process waiting on queue.
+void wake_up_all(wait_queue *queue);
+
+// Takes job off the queue it's waiting on, if any, without waking it up, e.g. when it's killed.
+void cancel_wait(pcb *job);
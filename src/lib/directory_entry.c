@@ -7,14 +7,16 @@
 #include <time.h>
 
 #include "macros.h"
+#include "tagged_alloc.h"
 
 #include "../fat/fat_util.h"
 
 directory_entry *create_directory_entry() {
-    directory_entry *d = (directory_entry *) malloc(sizeof(directory_entry));
+    directory_entry *d = (directory_entry *) tagged_malloc(MEM_DIR_ENTRIES, sizeof(directory_entry));
     HANDLE_SYS_CALL(d == NULL, "Error mallocing directory entry");
 
     d->firstBlock = EOF_IDX;
+    d->lastBlock = EOF_IDX;
     d->size = 0;
     d->type = (uint8_t) REGULAR;
     d->perm = (uint8_t) READ_WRITE;
@@ -24,7 +26,7 @@ directory_entry *create_directory_entry() {
         d->name[i] = 0;
     }
 
-    for (int i = 0; i < 16; i++) {
+    for (int i = 0; i < 14; i++) {
         d->reserved[i] = 0;
     }
 
@@ -32,10 +34,18 @@ directory_entry *create_directory_entry() {
 }
 
 void free_directory_entry(void *dir_entry) {
-    free(dir_entry);
+    tagged_free(dir_entry);
     dir_entry = NULL;
 }
 
+void stat_directory_entry(directory_entry *de, file_stat *st) {
+    memcpy(st->name, de->name, sizeof(st->name));
+    st->size = de->size;
+    st->firstBlock = de->firstBlock;
+    st->perm = de->perm;
+    st->mtime = de->mtime;
+}
+
 bool ll_find_removed_file(void *file_name, void *ll_val) {
     return ((directory_entry *) ll_val)->name[0] == (char) DELETED;
 }
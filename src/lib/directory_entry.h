@@ -51,16 +51,42 @@ typedef struct directory_entry_st {
     // Creation/modification time of the file.
     time_t mtime;
 
-    // Extra 16 bytes reserved so struct is 64 bytes.
-    char reserved[16];
+    // Cached block number of the block holding the last byte of the file, so that
+    // appends don't have to walk the FAT. EOF_IDX if the file is empty, and 0 if
+    // it hasn't been looked up yet (block 0 is never part of a file).
+    uint16_t lastBlock;
+
+    // Extra 14 bytes reserved so struct is 64 bytes.
+    char reserved[14];
 } directory_entry;
 
+// The parts of a directory entry that describe a file, as returned by f_stat() and f_readdir_batch().
+typedef struct file_stat_st {
+    // Null-terminated file name.
+    char name[32];
+
+    // Number of bytes in the file.
+    uint32_t size;
+
+    // The first block number of the file (EOF_IDX if the file is empty).
+    uint16_t firstBlock;
+
+    // Should be cast from the FilePermission enum.
+    uint8_t perm;
+
+    // Creation/modification time of the file.
+    time_t mtime;
+} file_stat;
+
 // Dynamically allocates a directory entry.
 directory_entry *create_directory_entry();
 
 // Frees entries in a dynamically allocated directory_entry.
 void free_directory_entry(void *dir_entry);
 
+// Fills st with the stats of the file with directory entry de.
+void stat_directory_entry(directory_entry *de, file_stat *st);
+
 // Predicate to match a directory entry in directory entry linked list to an entry where the file was removed.
 // ll_val is not used.
 bool ll_find_removed_file(void *file_name, void *ll_val);
@@ -1,58 +1,85 @@
 #include "errno.h"
+#include "pcb.h"
+#include "../kernel/scheduler.h"
 #include "../user/file_user_funcs.h"
 
+// Error number when there's no active process, e.g. in the standalone PennFAT.
 errno_st ERRNO;
 
 void set_errno(errno_st input) {
+    // Each process has its own, so one on another core can't overwrite it before p_perror.
+    pcb *job = get_active_job();
+
+    if (job != NULL) {
+        job->error = input;
+#ifdef SYSSTAT
+        job->errors_set++;
+#endif
+    }
+
     ERRNO = input;
 }
 
 void p_perror(char *shell_pass_in) {
     char result[1000] = "";
+    pcb *job = get_active_job();
+    errno_st error = job != NULL ? job->error : ERRNO;
 
-    if (ERRNO == NOCHILDCREATED) {
+    if (error == NOCHILDCREATED) {
         strcat(result, "p_perror: k_process_create failed to create a child.\n");
-    } else if (ERRNO == ACTIVEJOBNULL) {
+    } else if (error == ACTIVEJOBNULL) {
         strcat(result, "p_perror: Active job is null (idle).\n");
-    } else if (ERRNO == NOTINPCBTABLE) {
+    } else if (error == NOTINPCBTABLE) {
         strcat(result, "p_perror: The pid could not be found in the pcb table.\n");
-    } else if (ERRNO == KILLZOMBIE) {
+    } else if (error == KILLZOMBIE) {
         strcat(result, "p_perror: Attempted to send signal to a zombie process or nonexistant process.\n");
-    } else if (ERRNO == NOSUCHCHILD) {
+    } else if (error == NOSUCHCHILD) {
         strcat(result, "p_perror: The parent does not have a child with desired pid.\n");
-    } else if (ERRNO == NOTFOUNDINSCHEDULER) {
+    } else if (error == NOTFOUNDINSCHEDULER) {
         strcat(result, "p_perror: Job could not be found in the scheduler queue of right priority.\n");
-    } else if (ERRNO == INVALIDPRIORITY) {
+    } else if (error == INVALIDPRIORITY) {
         strcat(result, "p_perror: Priorities can only be -1, 0, 1.\n");
-    } else if (ERRNO == INVALIDSIGNAL) {
+    } else if (error == INVALIDSIGNAL) {
         strcat(result, "p_perror: Signals can only be term, stop, cont.\n");
-    } else if (ERRNO == INVALID_WHENCE) {
+    } else if (error == INVALIDWEIGHT) {
+        strcat(result, "p_perror: Scheduler weights must be positive.\n");
+    } else if (error == INVALIDSTACKSIZE) {
+        strcat(result, "p_perror: Stacks can be at most 64 MiB.\n");
+    } else if (error == INVALID_WHENCE) {
         strcat(result, "p_perror: Make sure `whence` is correct.\n");
-    } else if (ERRNO == INVALID_OFFSET) {
+    } else if (error == INVALID_OFFSET) {
         strcat(result, "p_perror: Offset cannot be negative.\n");
-    } else if (ERRNO == FILE_NOT_FOUND) {
+    } else if (error == FILE_NOT_FOUND) {
         strcat(result, "p_perror: File not found with given fd in k_lseek.\n");
-    } else if (ERRNO == UNALLOCATED_BLOCK) {
+    } else if (error == UNALLOCATED_BLOCK) {
         strcat(result, "p_perror: The first block is 0xFFFF, please allocate a block for it.\n");
-    } else if (ERRNO == PERMISSION_DENIED) {
+    } else if (error == PERMISSION_DENIED) {
         strcat(result, "p_perror: Insufficient file permissions.\n");
-    } else if (ERRNO == INVALID_MODE) {
+    } else if (error == BROKEN_PIPE) {
+        strcat(result, "p_perror: Nothing reads from the pipe anymore.\n");
+    } else if (error == NOT_A_FILE) {
+        strcat(result, "p_perror: fd is a pipe, not a file.\n");
+    } else if (error == SAME_PIPE) {
+        strcat(result, "p_perror: Cannot splice a pipe into itself.\n");
+    } else if (error == INVALID_MODE) {
         strcat(result, "p_perror: f_open Mode set to an invalid value.\n");
-    } else if (ERRNO == INVALID_FILE_NAME) {
+    } else if (error == INVALID_FILE_NAME) {
         strcat(result, "p_perror: f_open File name is NULL.\n");
-    } else if (ERRNO == INVALID_FILE_NAME_POSIX) {
+    } else if (error == INVALID_FILE_NAME_POSIX) {
         strcat(result, "p_perror: f_open File name does not match POSIX standard.\n");
-    } else if (ERRNO == ATTEMPTED_DOUBLE_WRITE) {
+    } else if (error == ATTEMPTED_DOUBLE_WRITE) {
         strcat(result, "p_perror: f_open File is already open in write mode.\n");
-    } else if (ERRNO == READ_FILE_NOT_FOUND) {
+    } else if (error == READ_FILE_NOT_FOUND) {
         strcat(result, "p_perror: f_open File not found and was opened in F_READ mode.\n");
-    } else if (ERRNO == CLOSE_UNOPEN_FILE) {
+    } else if (error == CLOSE_UNOPEN_FILE) {
         strcat(result, "p_perror: f_close File is not open.\n");
-    } else if (ERRNO == DOUBLE_DELETION) {
+    } else if (error == DOUBLE_DELETION) {
         strcat(result, "p_perror: File has already been deleted.\n");
-    } else if (ERRNO == FILE_NOT_FOUND_OFT) {
+    } else if (error == FILE_NOT_FOUND_OFT) {
         strcat(result, "p_perror: fd not found in OFT\n");
-    } else if (ERRNO == NO_MORE_SPACE) {
+    } else if (error == TOO_MANY_OPEN_FILES) {
+        strcat(result, "p_perror: f_open OFT has no free fd numbers left.\n");
+    } else if (error == NO_MORE_SPACE) {
         strcat(result, "p_perror: no more space in the fs\n");
     } else {
         return;
@@ -18,6 +18,8 @@ typedef enum {
     NOTFOUNDINSCHEDULER,
     INVALIDPRIORITY,
     INVALIDSIGNAL,
+    INVALIDWEIGHT,
+    INVALIDSTACKSIZE,
 
     // File kernel errors
     INVALID_WHENCE,
@@ -25,6 +27,9 @@ typedef enum {
     FILE_NOT_FOUND,
     UNALLOCATED_BLOCK,
     PERMISSION_DENIED,
+    BROKEN_PIPE,
+    NOT_A_FILE,
+    SAME_PIPE,
 
     // File user errors
     INVALID_MODE,
@@ -35,6 +40,7 @@ typedef enum {
     CLOSE_UNOPEN_FILE,
     DOUBLE_DELETION,
     FILE_NOT_FOUND_OFT,
+    TOO_MANY_OPEN_FILES,
 
     // Critical Errors
     NO_MORE_SPACE
@@ -10,47 +10,122 @@
 #include <unistd.h>
 
 #include "macros.h"
+#include "tagged_alloc.h"
 #include "../fat/fat_util.h"
 #include "../lib/pcb.h"
 #include "../shell/shell.h"
 #include "../kernel/scheduler.h"
 #include "../user/process_user_funcs.h"
 
-bool OFT_find_fd_by_name_predicate(void *fd_name, void *ll_val) {
-    if (ll_val == NULL) {
-        return false;
+void init_oft(open_file_table *OFT) {
+    for (int i = 0; i < MAX_OPEN_FDS; i++) {
+        OFT->entries[i] = NULL;
+    }
+
+    for (int i = 0; i < OFT_BITMAP_WORDS; i++) {
+        OFT->used[i] = 0;
+    }
+
+    // Preserving the STDIN, STDOUT and STDERR fd numbers.
+    OFT->used[0] = (1ULL << STDIN_FILENO) | (1ULL << STDOUT_FILENO) | (1ULL << STDERR_FILENO);
+    OFT->size = 0;
+}
+
+int oft_insert(open_file_table *OFT, file_descriptor *fd) {
+    for (int i = 0; i < OFT_BITMAP_WORDS; i++) {
+        // Skip words where every fd number is taken.
+        if (OFT->used[i] == UINT64_MAX) {
+            continue;
+        }
+
+        int ind = i * 64 + __builtin_ctzll(~OFT->used[i]);
+        OFT->used[i] |= 1ULL << (ind % 64);
+        OFT->entries[ind] = fd;
+        OFT->size++;
+        fd->ind = ind;
+        return ind;
     }
-    file_descriptor *fd = ll_val;
-    directory_entry *de = fd->de;
-    char *de_name = de->name;
-    return strcmp((char *) fd_name, de_name) == 0;
+
+    return -1;
 }
 
-bool OFT_find_fd_by_fd_predicate(void *fd_ind, void *ll_val) {
-    if (ll_val == NULL) {
+file_descriptor *oft_get(open_file_table *OFT, int ind) {
+    if (ind < 0 || ind >= MAX_OPEN_FDS) {
+        return NULL;
+    }
+
+    return OFT->entries[ind];
+}
+
+bool oft_remove(open_file_table *OFT, int ind, void (*free_value)(void *)) {
+    file_descriptor *fd = oft_get(OFT, ind);
+
+    if (fd == NULL) {
         return false;
     }
-    file_descriptor *fd = ll_val;
-    int *fd_int = (int *) fd_ind;
-    return fd->ind == *fd_int;
+
+    OFT->entries[ind] = NULL;
+    OFT->used[ind / 64] &= ~(1ULL << (ind % 64));
+    OFT->size--;
+    free_value(fd);
+    return true;
+}
+
+int oft_next(open_file_table *OFT, int ind) {
+    ind++;
+
+    while (ind < MAX_OPEN_FDS) {
+        // Only look at the entries in this word at or after ind.
+        uint64_t word = OFT->used[ind / 64] & (UINT64_MAX << (ind % 64));
+
+        if (word == 0) {
+            ind = (ind / 64 + 1) * 64;
+            continue;
+        }
+
+        ind = (ind / 64) * 64 + __builtin_ctzll(word);
+
+        // The reserved STDIN, STDOUT and STDERR fd numbers have no entry.
+        if (OFT->entries[ind] != NULL) {
+            return ind;
+        }
+
+        ind++;
+    }
+
+    return -1;
 }
 
-bool exists_other_fd_by_d_pos(linked_list *OFT, int d_pos, int ind) {
-    linked_list_elem *curr_elem = OFT->head;
-    while (curr_elem != NULL) {
-        file_descriptor *fd = curr_elem->val;
-        if (fd != NULL) {
-            if (fd->ind != ind && fd->d_pos == d_pos) {
-                return true;
-            }
+file_descriptor *oft_find_by_name(open_file_table *OFT, const char *fd_name) {
+    for (int i = oft_next(OFT, -1); i != -1; i = oft_next(OFT, i)) {
+        file_descriptor *fd = OFT->entries[i];
+
+        if (fd->de != NULL && strcmp(fd_name, fd->de->name) == 0) {
+            return fd;
         }
-        curr_elem = curr_elem->next;
     }
+
+    return NULL;
+}
+
+void clear_oft(open_file_table *OFT, void (*free_value)(void *)) {
+    for (int i = oft_next(OFT, -1); i != -1; i = oft_next(OFT, i)) {
+        oft_remove(OFT, i, free_value);
+    }
+}
+
+bool exists_other_fd_by_d_pos(open_file_table *OFT, int d_pos, int ind) {
+    for (int i = oft_next(OFT, -1); i != -1; i = oft_next(OFT, i)) {
+        if (i != ind && OFT->entries[i]->d_pos == d_pos) {
+            return true;
+        }
+    }
+
     return false;
 }
 
 void free_file_descriptor(void *file_descriptor) {
-    free(file_descriptor);
+    tagged_free(file_descriptor);
     file_descriptor = NULL;
 }
 
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "../kernel/scheduler.h"
@@ -16,7 +17,10 @@
 typedef enum {
     F_WRITE = 1,
     F_READ = 2,
-    F_APPEND = 3
+    F_APPEND = 3,
+    // Writes over the existing contents in place, keeping the file's blocks.
+    // The file is truncated to the furthest byte written once the fd is closed.
+    F_OVERWRITE = 4
 } mode;
 
 typedef enum {
@@ -25,10 +29,15 @@ typedef enum {
     F_SEEK_END = 2
 } whence;
 
+struct kernel_pipe_st;
+
 typedef struct fd_st {
-    // The corresponding Directory Entry.
+    // The corresponding Directory Entry. NULL if the fd is the end of a pipe.
     directory_entry *de;
 
+    // The pipe the fd is the read (mode F_READ) or write (mode F_WRITE) end of. NULL for a file.
+    struct kernel_pipe_st *pipe;
+
     // The index assigned to the file descriptor.
     int ind;
 
@@ -38,21 +47,65 @@ typedef struct fd_st {
     // The mode in which this file was opened.
     int mode;
 
-    // The offset in the fs of the data region.
+    // The current position, as a byte offset from the start of the file.
     int f_pos;
 
-    // The offset in the fs of the directory entry.
+    // The block this fd last read or wrote and its index in the file's chain. Lookups start
+    // from it, so sequential reads and writes don't walk the FAT. EOF_IDX if nothing is cached.
+    uint16_t pos_block;
+    int pos_block_idx;
+
+    // The furthest offset written through this fd.
+    int w_end;
+
+    // The offset in the fs of the directory entry. -1 for a pipe.
     int d_pos;
 } file_descriptor;
 
-// The predicate used to find an element in a linked list via name.
-bool OFT_find_fd_by_name_predicate(void *fd_name, void *ll_val);
+// Number of fd numbers taken by STDIN, STDOUT and STDERR, which are never in the OFT.
+#define NUM_STD_FDS 3
+
+// Number of 64 bit words in the OFT bitmap.
+#define OFT_BITMAP_WORDS (MAX_OPEN_FDS / 64)
+
+typedef struct open_file_table_st {
+    // File descriptors indexed by their fd number. NULL if the fd number is free.
+    file_descriptor *entries[MAX_OPEN_FDS];
+
+    // Bitmap of the fd numbers in use. Bit i of word j is set iff fd (64 * j + i) is taken.
+    // STDIN, STDOUT and STDERR are always marked as taken.
+    uint64_t used[OFT_BITMAP_WORDS];
+
+    // Number of file descriptors currently in the table.
+    int size;
+} open_file_table;
+
+// Initializes an empty OFT. Only the STDIN, STDOUT and STDERR fd numbers are taken.
+void init_oft(open_file_table *OFT);
+
+// Inserts fd into the OFT under the lowest available fd number and sets fd->ind to it.
+// Returns the fd number, or -1 if the OFT is full.
+int oft_insert(open_file_table *OFT, file_descriptor *fd);
+
+// Returns the file descriptor with fd number ind, or NULL if it is not open.
+file_descriptor *oft_get(open_file_table *OFT, int ind);
+
+// Removes the file descriptor with fd number ind from the OFT and frees it with free_value.
+// The fd number becomes available again. Returns true if something was removed.
+bool oft_remove(open_file_table *OFT, int ind, void (*free_value)(void *));
+
+// Returns the lowest open fd number greater than ind, or -1 if there is none.
+// Used to iterate over the OFT: for (int i = oft_next(OFT, -1); i != -1; i = oft_next(OFT, i)).
+int oft_next(open_file_table *OFT, int ind);
+
+// Returns a file descriptor in the OFT that references the file fd_name, or NULL if there is none.
+file_descriptor *oft_find_by_name(open_file_table *OFT, const char *fd_name);
 
-// The predicate used to find an element in a linked list via fd number.
-bool OFT_find_fd_by_fd_predicate(void *fd_ind, void *ll_val);
+// Removes and frees every file descriptor in the OFT.
+void clear_oft(open_file_table *OFT, void (*free_value)(void *));
 
 // Returns true if there is an element in the OFT that has the same directory entry but a different fd.
-bool exists_other_fd_by_d_pos(linked_list *OFT, int d_pos, int ind);
+bool exists_other_fd_by_d_pos(open_file_table *OFT, int d_pos, int ind);
 
 // Frees the given fd pointer.
 void free_file_descriptor(void *file_descriptor);
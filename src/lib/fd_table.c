@@ -0,0 +1,93 @@
+// Implementation of the per-process fd table.
+
+#include "fd_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "tagged_alloc.h"
+
+fd_table *create_fd_table() {
+    fd_table *table = (fd_table *) tagged_malloc(MEM_FD_TABLES, sizeof(fd_table));
+    HANDLE_SYS_CALL(table == NULL, "Error mallocing fd table");
+
+    table->fds = (int *) tagged_malloc(MEM_FD_TABLES, FD_TABLE_INIT_CAPACITY * sizeof(int));
+    HANDLE_SYS_CALL(table->fds == NULL, "Error mallocing fd table");
+
+    table->capacity = FD_TABLE_INIT_CAPACITY;
+    table->count = 0;
+    table->refs = 1;
+    return table;
+}
+
+fd_table *share_fd_table(fd_table *table) {
+    table->refs++;
+    return table;
+}
+
+fd_table *unshare_fd_table(fd_table *table) {
+    if (table->refs == 1) {
+        return table;
+    }
+
+    fd_table *copy = (fd_table *) tagged_malloc(MEM_FD_TABLES, sizeof(fd_table));
+    HANDLE_SYS_CALL(copy == NULL, "Error mallocing fd table");
+
+    copy->fds = (int *) tagged_malloc(MEM_FD_TABLES, table->capacity * sizeof(int));
+    HANDLE_SYS_CALL(copy->fds == NULL, "Error mallocing fd table");
+
+    memcpy(copy->fds, table->fds, table->count * sizeof(int));
+    copy->capacity = table->capacity;
+    copy->count = table->count;
+    copy->refs = 1;
+
+    table->refs--;
+    return copy;
+}
+
+bool release_fd_table(fd_table *table) {
+    table->refs--;
+
+    if (table->refs > 0) {
+        return false;
+    }
+
+    tagged_free(table->fds);
+    tagged_free(table);
+    return true;
+}
+
+void fd_table_add(fd_table *table, int fd) {
+    if (table->count == table->capacity) {
+        table->capacity *= 2;
+        table->fds = (int *) tagged_realloc(MEM_FD_TABLES, table->fds, table->capacity * sizeof(int));
+        HANDLE_SYS_CALL(table->fds == NULL, "Error growing fd table");
+    }
+
+    table->fds[table->count] = fd;
+    table->count++;
+}
+
+bool fd_table_remove(fd_table *table, int fd) {
+    for (int i = 0; i < table->count; i++) {
+        if (table->fds[i] == fd) {
+            // Fill the hole with the last fd so the used slots stay contiguous.
+            table->count--;
+            table->fds[i] = table->fds[table->count];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool fd_table_contains(fd_table *table, int fd) {
+    for (int i = 0; i < table->count; i++) {
+        if (table->fds[i] == fd) {
+            return true;
+        }
+    }
+
+    return false;
+}
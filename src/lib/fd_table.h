@@ -0,0 +1,48 @@
+// Declaration of the per-process fd table.
+
+#pragma once
+
+#include <stdbool.h>
+
+// Number of fd slots a new fd table starts out with.
+#define FD_TABLE_INIT_CAPACITY 4
+
+typedef struct fd_table_st {
+    // OFT fd numbers opened by the processes sharing this table.
+    // Only the first count entries are used, in no particular order.
+    int *fds;
+
+    // Number of slots allocated in fds.
+    int capacity;
+
+    // Number of open fds in the table.
+    int count;
+
+    // Number of processes sharing this table. A process that wants to change a
+    // shared table must unshare it first (copy-on-write).
+    int refs;
+} fd_table;
+
+// Dynamically allocates an empty fd table referenced by one process.
+fd_table *create_fd_table();
+
+// Adds another process reference to table and returns it.
+fd_table *share_fd_table(fd_table *table);
+
+// Returns a table that is safe for the calling process to change. This is table
+// itself if no other process references it, otherwise a copy of it, in which
+// case the caller's reference to table is dropped.
+fd_table *unshare_fd_table(fd_table *table);
+
+// Drops a process reference to table and frees it once nothing references it.
+// Returns true if table was freed.
+bool release_fd_table(fd_table *table);
+
+// Adds fd to table, growing it if necessary.
+void fd_table_add(fd_table *table, int fd);
+
+// Removes fd from table. Returns true if fd was in the table.
+bool fd_table_remove(fd_table *table, int fd);
+
+// Returns true if fd is in table.
+bool fd_table_contains(fd_table *table, int fd);
@@ -1,6 +1,7 @@
 // Implementation of a Generic Linked List data structure.
 
 #include "linked_list.h"
+#include "tagged_alloc.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -17,7 +18,7 @@ int is_empty(linked_list *linked_list) {
 void push_back(linked_list *linked_list, void *v) {
     linked_list_elem *new_node;
 
-    new_node = malloc(sizeof(*new_node));
+    new_node = tagged_malloc(MEM_LIST_NODES, sizeof(*new_node));
     if (new_node == NULL) {
         perror("Memory Allocation Failed For linked_list Node\n");
         return;
@@ -46,7 +47,7 @@ void push_back(linked_list *linked_list, void *v) {
 
 void push_back_with_pid(linked_list *linked_list, void *v, int pid) {
     linked_list_elem *new_node;
-    new_node = malloc(sizeof(*new_node));
+    new_node = tagged_malloc(MEM_LIST_NODES, sizeof(*new_node));
 
     if (new_node == NULL) {
         perror("Memory Allocation Failed For linked_list Node\n");
@@ -91,7 +92,7 @@ void *pop_head(linked_list *linked_list) {
 
         linked_list->size--;
 
-        free(cur_head);
+        tagged_free(cur_head);
         cur_head = NULL;
     }
 
@@ -135,7 +136,7 @@ bool remove_elem(linked_list *linked_list, bool (*predicate)(void *, void *), vo
 
                 linked_list->size--;
                 free_value(cur_elem->val);
-                free(cur_elem);
+                tagged_free(cur_elem);
 
                 cur_elem = NULL;
 
@@ -176,7 +177,7 @@ void *extract_elem(linked_list *linked_list, bool (*predicate)(void *, void *),
                     linked_list->tail = prev;
                 }
                 linked_list->size--;
-                free(cur_elem);
+                tagged_free(cur_elem);
 
                 return cur_val;
             }
@@ -1,13 +1,23 @@
 // Definition of the logger functions.
+// Events are logged as fixed-size binary records into a ring in memory, which costs no more than
+// reading the clock. The logger process decodes them into the text format and writes them to
+// the log file in bulk. If it falls behind, the ring is written on the way out of a system call
+// or in the scheduler instead, so no event is lost. Every event is logged in the kernel, so the
+// ring needs no other lock.
 
 #include "log.h"
 
 #include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include "macros.h"
+#include "tagged_alloc.h"
+#include "../kernel/pcb_table.h"
+#include "../kernel/wait_queue.h"
 
 static char evt_names[11][10] = {
         "SCHEDULE",
@@ -23,14 +33,68 @@ static char evt_names[11][10] = {
         "CONTINUED"
 };
 
+// Event of a log_nice_event() record.
+#define NICE_EVT 11
+
+// Number of records in the ring past which it's written without waiting for the logger.
+#define LOG_CATCH_UP_THRESHOLD (LOG_RING_SIZE / 4 * 3)
+
+// Size of the buffer records are decoded into before they're written.
+#define LOG_WRITE_BUFFER_SIZE (64 * 1024)
+
+typedef struct log_record_st {
+    // When the event happened, in ns since the scheduler started. The clock ticks only advance
+    // when the scheduler runs, so this is the only precise time of events within a time slice.
+    long long nsec;
+
+    unsigned int tick;
+    pid_t pid;
+
+    // Generation of the pid's command when the event happened.
+    unsigned int generation;
+
+    // A LogEvent, or NICE_EVT.
+    int8_t event;
+    int8_t priority;
+
+    // The priority before a nice.
+    int8_t old_priority;
+} log_record;
+
 static unsigned int clock_ticks = 0;
 
 static int log_fd = -1;
 
+// Records not written yet, the oldest one at index head.
+static log_record ring[LOG_RING_SIZE];
+static int ring_head = 0;
+static int ring_count = 0;
+
+// Command of a pid's process, copied when it's created, since it may be freed before its events
+// are written. Each process the pid is recycled for gets the next generation.
+typedef struct log_name_st {
+    pid_t pid;
+    unsigned int generation;
+    char *cmd;
+} log_name;
+
+// Command of each pid. NULL for the shell, which is never created.
+static log_name names[MAX_PID];
+
+// Commands of the earlier generations of recycled pids, which records in the ring may still refer
+// to. They're freed once the ring has been written, outside of the scheduler.
+static linked_list retired_names;
+
+// Where the logger process waits for the ring to fill up.
+static wait_queue log_waiters;
+
 void init_log(char *log_name) {
     int fd = open(log_name, O_WRONLY | O_CREAT | O_TRUNC, FILE_OPEN_MODE);
     HANDLE_SYS_CALL(fd < 0, "Error opening log file.");
     log_fd = fd;
+
+    init_wait_queue(&log_waiters);
+    init_linked_list(&retired_names);
 }
 
 void increment_clock_ticks() {
@@ -41,13 +105,164 @@ unsigned int get_clock_ticks() {
     return clock_ticks;
 }
 
+static void free_log_name(void *name) {
+    tagged_free(((log_name *) name)->cmd);
+    tagged_free(name);
+}
+
+// Returns the command of the process rec is an event of.
+static char *name_of(log_record *rec) {
+    log_name *name = &names[rec->pid];
+
+    if (name->cmd != NULL && name->generation == rec->generation) {
+        return name->cmd;
+    }
+
+    for (linked_list_elem *elem = retired_names.head; elem != NULL; elem = elem->next) {
+        log_name *retired = (log_name *) elem->val;
+
+        if (retired->pid == rec->pid && retired->generation == rec->generation) {
+            return retired->cmd;
+        }
+    }
+
+    pcb *proc = find_pcb_in_table(rec->pid);
+    return proc != NULL ? proc->cmd : "";
+}
+
+// Decodes the records in the ring and writes them to the log file. Nothing else can log an event
+// or write the ring meanwhile, not even a signal handler on the same core.
+static void write_ring() {
+    static char buf[LOG_WRITE_BUFFER_SIZE];
+    int len = 0;
+
+    sigset_t set, old_set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTSTP);
+    sigprocmask(SIG_BLOCK, &set, &old_set);
+
+    for (; ring_count > 0; ring_count--) {
+        log_record *rec = &ring[ring_head];
+        char *name = name_of(rec);
+
+        // Room for the name and the numbers around it.
+        if (len + strlen(name) + 64 > sizeof(buf)) {
+            write(log_fd, buf, len);
+            len = 0;
+        }
+
+        if (rec->event == NICE_EVT) {
+            len += sprintf(buf + len, "[%u] NICE %d %d %d %s\n", rec->tick, rec->pid, rec->old_priority,
+                           rec->priority, name);
+        } else {
+            len += sprintf(buf + len, "[%u] %s %d %d %s\n", rec->tick, evt_names[(int) rec->event], rec->pid,
+                           rec->priority, name);
+        }
+
+        ring_head = (ring_head + 1) % LOG_RING_SIZE;
+    }
+
+    if (len > 0) {
+        write(log_fd, buf, len);
+    }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+}
+
+void flush_log() {
+    write_ring();
+
+    // No record refers to the earlier generations anymore.
+    clear(&retired_names, free_log_name);
+}
+
+void catch_up_log() {
+    if (log_fd != -1 && ring_count >= LOG_CATCH_UP_THRESHOLD) {
+        write_ring();
+    }
+}
+
+void log_writer() {
+    while (true) {
+        SYSTEM_CALL();
+
+        while (ring_count < LOG_RING_SIZE / 2) {
+            wait_on(&log_waiters);
+        }
+
+        flush_log();
+    }
+}
+
 void close_log() {
+    flush_log();
+
+    for (int i = 0; i < MAX_PID; i++) {
+        tagged_free(names[i].cmd);
+        names[i].cmd = NULL;
+    }
+
     HANDLE_SYS_CALL(close(log_fd) < 0, "Error closing log file.");
     log_fd = -1;
 }
 
+// Adds a record of the event to the ring.
+static void add_record(int event, pcb *proc, int old_priority) {
+    if (log_fd == -1) {
+        return;
+    }
+
+    // Only a single system call or scheduler pass logging more events than fit past the catch-up
+    // threshold, e.g. waking up thousands of waiters, gets here. Writing the ring in the middle of
+    // it is better than losing them.
+    if (ring_count == LOG_RING_SIZE) {
+        write_ring();
+    }
+
+    log_record *rec = &ring[(ring_head + ring_count) % LOG_RING_SIZE];
+    rec->nsec = nsec_since_boot();
+    rec->tick = clock_ticks;
+    rec->pid = proc->pid;
+    rec->generation = names[proc->pid].generation;
+    rec->event = event;
+    rec->priority = proc->priority;
+    rec->old_priority = old_priority;
+    ring_count++;
+
+    // Waking up the logger logs another event, which doesn't wake it up again.
+    if (ring_count == LOG_RING_SIZE / 2) {
+        wake_up_one(&log_waiters);
+    }
+}
+
 void log_event(LogEvent evt, pcb *proc) {
-    dprintf(log_fd, "[%u] %s %d %d %s\n", clock_ticks, evt_names[evt], proc->pid, proc->priority, proc->cmd);
+    if (evt == CREATE_EVT && log_fd != -1) {
+        log_name *name = &names[proc->pid];
+
+        // Names retired while the logger fell behind are freed here, since the scheduler can't.
+        if (ring_count == 0) {
+            clear(&retired_names, free_log_name);
+        }
+
+        // The pid may be recycled, in which case events of its last process may still be in the ring.
+        if (name->cmd != NULL && ring_count > 0) {
+            log_name *retired = (log_name *) tagged_malloc(MEM_LOG, sizeof(log_name));
+            HANDLE_SYS_CALL(retired == NULL, "Unable to allocate a log name\n");
+
+            *retired = *name;
+            push_back(&retired_names, retired);
+        } else {
+            tagged_free(name->cmd);
+        }
+
+        name->pid = proc->pid;
+        name->generation++;
+        name->cmd = tagged_strdup(MEM_LOG, proc->cmd);
+    }
+
+    add_record(evt, proc, proc->priority);
 
     char *status_str = NULL;
 
@@ -66,6 +281,6 @@ void log_event(LogEvent evt, pcb *proc) {
 }
 
 void log_nice_event(pcb *proc, int old_nice) {
-    dprintf(log_fd, "[%u] NICE %d %d %d %s\n", clock_ticks, proc->pid, old_nice, proc->priority, proc->cmd);
+    add_record(NICE_EVT, proc, old_nice);
 }
 
@@ -21,6 +21,9 @@ typedef enum {
     CONTINUED_EVT = 10
 } LogEvent;
 
+// Number of events kept in memory until they're written to the log file.
+#define LOG_RING_SIZE 4096
+
 // Open log file and store fd.
 void init_log(char *log_name);
 
@@ -30,10 +33,22 @@ unsigned int get_clock_ticks();
 // Increments the global clock tick counter.
 void increment_clock_ticks();
 
-// Close log file.
+// Writes the events kept in memory to the log file, in its text format. Has to be called in a
+// system call, or once the cores stopped.
+void flush_log();
+
+// Writes the events kept in memory if the logger fell behind and the ring is nearly full. Called
+// where no event is being logged, i.e. on the way out of a system call and in the scheduler.
+void catch_up_log();
+
+// Main function of the logger process, which writes the events to the log file whenever half
+// of the ring holding them is full, so they're written in bulk and not where they happen.
+void log_writer();
+
+// Writes the remaining events and closes the log file.
 void close_log();
 
-// Log an event for a pcb, except nice.
+// Log an event for a pcb, except nice. Only adds a record to the ring in memory.
 void log_event(LogEvent evt, pcb *proc);
 
 // Log nice.
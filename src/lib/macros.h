@@ -41,10 +41,16 @@
             exit(EXIT_FAILURE); \
         }
 
-#define TICKS_PER_SECOND 10
+// Clock ticks are a millisecond long.
+#define TICKS_PER_SECOND 1000
 
 #define SECONDS_TO_TICKS(sec) sec * TICKS_PER_SECOND
 
+// Rounds up, so a sleep is never shorter than asked for.
+#define MS_TO_TICKS(ms) (((unsigned long long) (ms) * TICKS_PER_SECOND + 999) / 1000)
+
+#define NSEC_TO_TICKS(nsec) ((nsec) / (1000000000LL / TICKS_PER_SECOND))
+
 #define MIN(a, b) (a < b ? a : b)
 
 #define MAX(a, b) (a > b ? a : b)
\ No newline at end of file
@@ -10,7 +10,10 @@
 #include "../kernel/scheduler.h"
 #include "../kernel/pcb_table.h"
 #include "../kernel/threads.h"
+#include "../kernel/wait_queue.h"
 #include "../lib/log.h"
+#include "../lib/tagged_alloc.h"
+#include "../user/stream_user_funcs.h"
 
 bool pid_equal_predicate(void *pid, void *target_pcb) {
     pid_t *target_pid = pid;
@@ -29,37 +32,65 @@ void free_process_pcb(void *proc) {
         reset_active_job();
     }
 
+    // Make sure nothing still references the process once it's freed.
+    cancel_sleep_alarm(process);
+    cancel_wait(process);
+    remove_job_from_scheduler(process);
+
     // remove process from process table
     delete_pcb_in_table(process->pid);
 
     // Free the process pcb values
     if (process->cmd != NULL) {
-        free(process->cmd);
+        tagged_free(process->cmd);
     }
 
     if (process->argv != NULL) {
         for (int i = 0; process->argv[i] != NULL; i++) {
-            free(process->argv[i]);
+            tagged_free(process->argv[i]);
         }
 
-        free(process->argv);
+        tagged_free(process->argv);
     }
 
     if (process->childLL != NULL) {
         clear(process->childLL, free_process_pcb);
-        free(process->childLL);
+        tagged_free(process->childLL);
     }
 
     if (process->zombieLL != NULL) {
         clear(process->zombieLL, free_process_pcb);
-        free(process->zombieLL);
+        tagged_free(process->zombieLL);
+    }
+
+    // The children in it were freed with the other two lists.
+    if (process->changedLL != NULL) {
+        while (!is_empty(process->changedLL)) {
+            pop_head(process->changedLL);
+        }
+
+        tagged_free(process->changedLL);
     }
 
+    tagged_free(process->child_wait);
+
     if (process->context != NULL) {
         free_context(process->context);
     }
 
-    free(process);
+    // The fds themselves were closed when the process was terminated.
+    if (process->fds != NULL) {
+        release_fd_table(process->fds);
+    }
+
+    // Whatever the process didn't flush before it terminated is lost.
+    free_streams(process);
+
+#ifdef SYSSTAT
+    tagged_free(process->syscalls);
+#endif
+
+    tagged_free(process);
 }
 
 bool process_complete(pcb *j) {
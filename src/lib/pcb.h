@@ -5,6 +5,8 @@
 #include <sys/types.h>
 #include <ucontext.h>
 
+#include "../lib/errno.h"
+#include "../lib/fd_table.h"
 #include "../lib/linked_list.h"
 #include "../lib/macros.h"
 #include "../lib/status.h"
@@ -12,6 +14,48 @@
 // Placeholder value for the PID of a process that has already finished.
 #define FINISHED_PID_VAL -1
 
+// Value of run_queue for a process that isn't in any scheduler queue.
+#define NOT_QUEUED -1
+
+// Value of timer_slot for a process that isn't sleeping.
+#define NOT_SLEEPING -1
+
+struct wait_queue_st;
+struct file_stream_st;
+
+// What a process's time is being spent on, for its resource usage.
+typedef enum {
+    USAGE_IDLE,
+    USAGE_RUNNING,
+    USAGE_WAITING,
+    USAGE_BLOCKED
+} usage_state;
+
+// Resources used by a process.
+typedef struct proc_usage_st {
+    // Time spent running, waiting in a scheduler queue, and blocked, in nanoseconds. The time
+    // in the current state is only added once it changes, see get_process_usage().
+    long long run_nsec;
+    long long wait_nsec;
+    long long blocked_nsec;
+
+    // Times the process gave up the CPU itself (by blocking, stopping or exiting), and times it
+    // was preempted.
+    unsigned long voluntary_switches;
+    unsigned long involuntary_switches;
+
+    // Bytes moved by f_read, f_write and f_splice.
+    long long bytes_read;
+    long long bytes_written;
+
+    // FAT blocks allocated by the process's writes.
+    unsigned long blocks_allocated;
+
+    // The current state, and when the process entered it in nanoseconds since boot.
+    usage_state state;
+    long long state_since;
+} proc_usage;
+
 typedef struct pcb_st {
     // Current status of the job.
     process_status status;
@@ -34,8 +78,13 @@ typedef struct pcb_st {
     // Dynamically allocated string representing the pipeline name.
     char *cmd;
 
-    // should be a nonzero starting value if cmd is sleep
-    int remaining_clock_ticks;
+    // Clock tick at which the process wakes up from p_sleep.
+    unsigned int wake_tick;
+
+    // Neighbours in the timer wheel slot the process is in, and which slot that is (NOT_SLEEPING if it isn't sleeping).
+    struct pcb_st *timer_prev;
+    struct pcb_st *timer_next;
+    int timer_slot;
 
     // zombie child processes
     linked_list *zombieLL;
@@ -43,15 +92,61 @@ typedef struct pcb_st {
     // nonzombie child processes
     linked_list *childLL;
 
+    // Children whose status changed since p_waitpid last reported it, in the order they changed.
+    linked_list *changedLL;
+
+    // Where the process waits in p_waitpid for a child's status to change.
+    struct wait_queue_st *child_wait;
+
+    // Neighbours in the wait queue the process is blocked on, and which queue that is (NULL if it isn't waiting).
+    struct pcb_st *wait_prev;
+    struct pcb_st *wait_next;
+    struct wait_queue_st *wait_queue;
+
     // priority level
     int priority;
 
+    // Neighbours in the scheduler queue, and which queue that is (NOT_QUEUED if the process isn't in one).
+    struct pcb_st *run_prev;
+    struct pcb_st *run_next;
+    int run_queue;
+
+    // Core whose queue the process is in, or it last ran on.
+    int core;
+
+    // How many system calls deep the process is. While it's in one, it holds the kernel lock and
+    // isn't preempted (with more than one core).
+    int kernel_depth;
+
+    // Whether the process can be preempted anywhere, e.g. while it's waiting in suspend().
+    bool preemptible;
+
+    // Error of the last failed system call.
+    errno_st error;
+
     // True if this is a background process
     bool is_bg;
 
-    // Array of open file descriptors
+    // stdin and stdout of the process.
     // Index 0 is stdin fd, Index 1 is stdout fd
-    int fd[MAX_OPEN_FDS];
+    int fd[2];
+
+    // Files opened by the process. Shared copy-on-write with the parent after p_spawn.
+    fd_table *fds;
+
+    // Buffered streams opened by the process, most recent first.
+    struct file_stream_st *streams;
+
+    // Resources used by the process so far.
+    proc_usage usage;
+
+#ifdef SYSSTAT
+    // Count and latency of each system call the process made, indexed by the call's id.
+    struct syscall_usage_st *syscalls;
+
+    // Number of times set_errno() was called by the process, to tell which system calls failed.
+    unsigned long errors_set;
+#endif
 
     // Array of string arguments passed to the process. Should be dynamically
     // allocated and null terminated (i.e. last element is NULL).
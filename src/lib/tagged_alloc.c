@@ -0,0 +1,169 @@
+// Definition of the tagged allocator.
+// Each allocation is prefixed with a header holding its size and tag, so tagged_free() knows what
+// to take off. Any core may allocate outside of the kernel lock, so the counters are atomic.
+
+#include "tagged_alloc.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Prefix of every allocation. Keeps the memory after it aligned like malloc()'s.
+typedef struct alloc_header_st {
+    _Alignas(max_align_t) size_t size;
+    mem_tag tag;
+} alloc_header;
+
+static const struct {
+    const char *name;
+    mem_subsystem subsystem;
+} tags[NUM_MEM_TAGS] = {
+        [MEM_LIST_NODES] = {"list nodes", SUBSYSTEM_LIB},
+        [MEM_DIR_ENTRIES] = {"directory entries", SUBSYSTEM_LIB},
+        [MEM_FDS] = {"file descriptors", SUBSYSTEM_LIB},
+        [MEM_FD_TABLES] = {"fd tables", SUBSYSTEM_LIB},
+        [MEM_LOG] = {"log", SUBSYSTEM_LIB},
+        [MEM_PCBS] = {"PCBs", SUBSYSTEM_KERNEL},
+        [MEM_CONTEXTS] = {"contexts", SUBSYSTEM_KERNEL},
+        [MEM_STACKS] = {"stacks", SUBSYSTEM_KERNEL},
+        [MEM_ARGV] = {"commands and argv", SUBSYSTEM_KERNEL},
+        [MEM_PIPES] = {"pipes", SUBSYSTEM_KERNEL},
+        [MEM_PROFILING] = {"profiling", SUBSYSTEM_KERNEL},
+        [MEM_FILE_SYSTEM] = {"file system", SUBSYSTEM_FAT},
+        [MEM_STREAMS] = {"streams", SUBSYSTEM_USER},
+        [MEM_JOBS] = {"jobs", SUBSYSTEM_SHELL},
+        [MEM_SHELL] = {"shell", SUBSYSTEM_SHELL},
+};
+
+static const char *subsystem_names[NUM_SUBSYSTEMS] = {"lib", "kernel", "fat", "user", "shell"};
+
+static mem_usage tag_usage[NUM_MEM_TAGS];
+static mem_usage subsystem_usage[NUM_SUBSYSTEMS];
+static mem_usage total_usage;
+
+// Raises *peak to value if it's higher.
+static void raise_peak(long long *peak, long long value) {
+    long long current = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (value > current &&
+           !__atomic_compare_exchange_n(peak, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Adds bytes and objects, either of which may be negative, to usage.
+static void add_usage(mem_usage *usage, long long bytes, long long objects) {
+    long long live_bytes = __atomic_add_fetch(&usage->live_bytes, bytes, __ATOMIC_RELAXED);
+    long long live_objects = __atomic_add_fetch(&usage->live_objects, objects, __ATOMIC_RELAXED);
+
+    if (objects > 0) {
+        __atomic_add_fetch(&usage->allocs, objects, __ATOMIC_RELAXED);
+    }
+
+    raise_peak(&usage->peak_bytes, live_bytes);
+    raise_peak(&usage->peak_objects, live_objects);
+}
+
+static void account(mem_tag tag, long long bytes, long long objects) {
+    add_usage(&tag_usage[tag], bytes, objects);
+    add_usage(&subsystem_usage[tags[tag].subsystem], bytes, objects);
+    add_usage(&total_usage, bytes, objects);
+}
+
+// Fills in the header at the start of block and returns the memory after it.
+static void *tag_block(alloc_header *block, mem_tag tag, size_t size) {
+    block->size = size;
+    block->tag = tag;
+    account(tag, size, 1);
+    return block + 1;
+}
+
+void *tagged_malloc(mem_tag tag, size_t size) {
+    alloc_header *block = (alloc_header *) malloc(sizeof(alloc_header) + size);
+    return block == NULL ? NULL : tag_block(block, tag, size);
+}
+
+void *tagged_calloc(mem_tag tag, size_t count, size_t size) {
+    if (size != 0 && count > (SIZE_MAX - sizeof(alloc_header)) / size) {
+        return NULL;
+    }
+
+    alloc_header *block = (alloc_header *) calloc(1, sizeof(alloc_header) + count * size);
+    return block == NULL ? NULL : tag_block(block, tag, count * size);
+}
+
+void *tagged_realloc(mem_tag tag, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return tagged_malloc(tag, size);
+    }
+
+    alloc_header *old = (alloc_header *) ptr - 1;
+    mem_tag old_tag = old->tag;
+    size_t old_size = old->size;
+
+    alloc_header *block = (alloc_header *) realloc(old, sizeof(alloc_header) + size);
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    account(old_tag, -(long long) old_size, -1);
+    return tag_block(block, tag, size);
+}
+
+char *tagged_strdup(mem_tag tag, const char *str) {
+    size_t size = strlen(str) + 1;
+    char *copy = (char *) tagged_malloc(tag, size);
+
+    if (copy != NULL) {
+        memcpy(copy, str, size);
+    }
+
+    return copy;
+}
+
+void tagged_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    alloc_header *block = (alloc_header *) ptr - 1;
+    account(block->tag, -(long long) block->size, -1);
+    free(block);
+}
+
+void account_mapping(mem_tag tag, long long size) {
+    account(tag, size, size < 0 ? -1 : 1);
+}
+
+// Copies usage field by field, since another core may be changing it.
+static void load_usage(mem_usage *usage, mem_usage *out) {
+    out->live_bytes = __atomic_load_n(&usage->live_bytes, __ATOMIC_RELAXED);
+    out->peak_bytes = __atomic_load_n(&usage->peak_bytes, __ATOMIC_RELAXED);
+    out->live_objects = __atomic_load_n(&usage->live_objects, __ATOMIC_RELAXED);
+    out->peak_objects = __atomic_load_n(&usage->peak_objects, __ATOMIC_RELAXED);
+    out->allocs = __atomic_load_n(&usage->allocs, __ATOMIC_RELAXED);
+}
+
+void get_mem_usage(mem_tag tag, mem_usage *usage) {
+    load_usage(&tag_usage[tag], usage);
+}
+
+void get_subsystem_mem_usage(mem_subsystem subsystem, mem_usage *usage) {
+    load_usage(&subsystem_usage[subsystem], usage);
+}
+
+void get_total_mem_usage(mem_usage *usage) {
+    load_usage(&total_usage, usage);
+}
+
+const char *mem_tag_name(mem_tag tag) {
+    return tags[tag].name;
+}
+
+mem_subsystem mem_tag_subsystem(mem_tag tag) {
+    return tags[tag].subsystem;
+}
+
+const char *mem_subsystem_name(mem_subsystem subsystem) {
+    return subsystem_names[subsystem];
+}
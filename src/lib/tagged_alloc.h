@@ -0,0 +1,80 @@
+// Declaration of the tagged allocator, which wraps malloc() and friends to account for the live
+// bytes and objects of each kind of allocation, and of each subsystem, with their high-water marks.
+
+#pragma once
+
+#include <stddef.h>
+
+// What an allocation is for. Grouped by the subsystem that owns them, see mem_tag_subsystem().
+typedef enum {
+    // lib
+    MEM_LIST_NODES,
+    MEM_DIR_ENTRIES,
+    MEM_FDS,
+    MEM_FD_TABLES,
+    MEM_LOG,
+
+    // kernel
+    MEM_PCBS,
+    MEM_CONTEXTS,
+    MEM_STACKS,
+    MEM_ARGV,
+    MEM_PIPES,
+    MEM_PROFILING,
+
+    // fat
+    MEM_FILE_SYSTEM,
+
+    // user
+    MEM_STREAMS,
+
+    // shell
+    MEM_JOBS,
+    MEM_SHELL,
+
+    NUM_MEM_TAGS
+} mem_tag;
+
+typedef enum {
+    SUBSYSTEM_LIB,
+    SUBSYSTEM_KERNEL,
+    SUBSYSTEM_FAT,
+    SUBSYSTEM_USER,
+    SUBSYSTEM_SHELL,
+
+    NUM_SUBSYSTEMS
+} mem_subsystem;
+
+// Memory of one tag, one subsystem, or all of them. Bytes are what the callers asked for, without
+// the allocator's own overhead.
+typedef struct mem_usage_st {
+    long long live_bytes;
+    long long peak_bytes;
+    long long live_objects;
+    long long peak_objects;
+
+    // Allocations ever made.
+    unsigned long allocs;
+} mem_usage;
+
+// Like malloc(), calloc(), realloc() and strdup(), for memory tagged with tag. The memory must be
+// freed with tagged_free().
+void *tagged_malloc(mem_tag tag, size_t size);
+void *tagged_calloc(mem_tag tag, size_t count, size_t size);
+void *tagged_realloc(mem_tag tag, void *ptr, size_t size);
+char *tagged_strdup(mem_tag tag, const char *str);
+
+// Like free(), for memory from the tagged allocator.
+void tagged_free(void *ptr);
+
+// Accounts for size bytes mapped with mmap() for tag, e.g. stacks, or unmapped if size is negative.
+void account_mapping(mem_tag tag, long long size);
+
+// Copies the memory of tag, of subsystem, or of every tag, to usage.
+void get_mem_usage(mem_tag tag, mem_usage *usage);
+void get_subsystem_mem_usage(mem_subsystem subsystem, mem_usage *usage);
+void get_total_mem_usage(mem_usage *usage);
+
+const char *mem_tag_name(mem_tag tag);
+mem_subsystem mem_tag_subsystem(mem_tag tag);
+const char *mem_subsystem_name(mem_subsystem subsystem);
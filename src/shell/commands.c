@@ -7,19 +7,259 @@
 #include "job.h"
 #include "../fat/fat_util.h"
 #include "../kernel/pcb_table.h"
+#include "../kernel/scheduler.h"
 #include "../kernel/threads.h"
 #include "../lib/fd.h"
 #include "../lib/macros.h"
 #include "../lib/signals.h"
 #include "../lib/status.h"
+#include "../lib/tagged_alloc.h"
 #include "../lib/errno.h"
 #include "../user/file_user_funcs.h"
 #include "../user/process_user_funcs.h"
 #include "../user/scheduler_user_funcs.h"
+#include "../user/stream_user_funcs.h"
+#include "../user/bench.h"
+#include "../user/profile.h"
 #include "../user/stress.h"
 
+// Moves everything left to read from src to dst.
+static void splice_all(int src, int dst) {
+    while (true) {
+        int bytes_moved = f_splice(src, dst, SPLICE_BUFFER_SIZE);
+        if (bytes_moved == -1) {
+            p_perror(NULL);
+        }
+
+        if (bytes_moved <= 0) {
+            break;
+        }
+    }
+}
+
+// Most processes top remembers the CPU time of between refreshes. Others show 0% CPU.
+#define MAX_TOP_SAMPLES 1024
+
+// A process as ps and top show it. It's copied out of the PCB table in the kernel, since writing
+// it out can block on a full pipe, which lets the other cores change the table and free the PCB.
+typedef struct proc_row_st {
+    pid_t pid;
+    pid_t ppid;
+    int priority;
+    char status;
+    proc_usage usage;
+    char *cmd;
+} proc_row;
+
+// A process as top shows it.
+typedef struct top_row_st {
+    proc_row *proc;
+
+    // CPU time since the last refresh, in nanoseconds.
+    long long cpu_nsec;
+} top_row;
+
+// CPU time of a process at top's last refresh.
+typedef struct top_sample_st {
+    pid_t pid;
+    long long run_nsec;
+} top_sample;
+
+// Returns the status ps and top show for proc, with B for blocked.
+static char status_code(pcb *proc) {
+    return proc->blocked && proc->status == RUNNING ? 'B' : get_status_code(proc->status);
+}
+
+// Returns a copy of every process in the PCB table, by pid, and stores how many in num_rows.
+static proc_row *copy_processes(int *num_rows) {
+    // Keeps the other cores from changing the table while walking it.
+    SYSTEM_CALL();
+
+    proc_row *rows = (proc_row *) tagged_malloc(MEM_SHELL, num_pcbs_in_table() * sizeof(proc_row));
+    HANDLE_SYS_CALL(rows == NULL, "Unable to allocate the process rows\n");
+
+    *num_rows = 0;
+
+    for (pcb *curr_pcb = next_pcb_in_table(0); curr_pcb != NULL; curr_pcb = next_pcb_in_table(curr_pcb->pid)) {
+        proc_row *row = &rows[(*num_rows)++];
+        row->pid = curr_pcb->pid;
+        row->ppid = curr_pcb->parent != NULL ? curr_pcb->parent->pid : 0;
+        row->priority = curr_pcb->priority;
+        row->status = status_code(curr_pcb);
+        get_process_usage(curr_pcb, &row->usage);
+        row->cmd = tagged_strdup(MEM_SHELL, curr_pcb->cmd);
+        HANDLE_SYS_CALL(row->cmd == NULL, "Unable to allocate the process rows\n");
+    }
+
+    return rows;
+}
+
+static void free_process_rows(proc_row *rows, int num_rows) {
+    for (int i = 0; i < num_rows; i++) {
+        tagged_free(rows[i].cmd);
+    }
+
+    tagged_free(rows);
+}
+
+static int compare_top_rows(const void *a, const void *b) {
+    const top_row *x = a;
+    const top_row *y = b;
+
+    if (x->cpu_nsec != y->cpu_nsec) {
+        return x->cpu_nsec < y->cpu_nsec ? 1 : -1;
+    }
+
+    return x->proc->pid - y->proc->pid;
+}
+
+// Prints one refresh of top: the load averages and the processes by CPU time since the last
+// refresh, which was interval_nsec ago. Replaces samples with the CPU times now.
+static void print_top(file_stream *out, top_sample *samples, int *num_samples, long long interval_nsec) {
+    int num_rows;
+    int num_running = 0;
+    proc_row *procs = copy_processes(&num_rows);
+    top_row *rows = (top_row *) tagged_malloc(MEM_SHELL, num_rows * sizeof(top_row));
+    HANDLE_SYS_CALL(rows == NULL, "Unable to allocate top rows\n");
+
+    double load[3];
+
+    {
+        SYSTEM_CALL();
+        get_load_averages(load);
+    }
+
+    for (int i = 0; i < num_rows; i++) {
+        top_row *row = &rows[i];
+        row->proc = &procs[i];
+
+        // A pid that's been recycled since starts over.
+        long long last_run_nsec = 0;
+
+        for (int j = 0; j < *num_samples; j++) {
+            if (samples[j].pid == row->proc->pid && samples[j].run_nsec <= row->proc->usage.run_nsec) {
+                last_run_nsec = samples[j].run_nsec;
+                break;
+            }
+        }
+
+        row->cpu_nsec = interval_nsec > 0 ? row->proc->usage.run_nsec - last_run_nsec : 0;
+
+        if (row->proc->status == 'R') {
+            num_running++;
+        }
+    }
+
+    *num_samples = 0;
+
+    for (int i = 0; i < num_rows && i < MAX_TOP_SAMPLES; i++) {
+        samples[(*num_samples)++] = (top_sample) {.pid = procs[i].pid, .run_nsec = procs[i].usage.run_nsec};
+    }
+
+    qsort(rows, num_rows, sizeof(top_row), compare_top_rows);
+
+    p_fprintf(out, "top - up %lld s, %d processes, %d running, load average: %.2f, %.2f, %.2f\n\n",
+              NSEC_TO_TICKS(nsec_since_boot()) / TICKS_PER_SECOND, num_rows, num_running, load[0], load[1],
+              load[2]);
+    p_fprintf(out, "PID PRI STAT  %%CPU    TICKS  VCSW IVCSW     READ  WRITTEN CMD\n");
+
+    for (int i = 0; i < num_rows; i++) {
+        top_row *row = &rows[i];
+        double cpu = interval_nsec > 0 ? 100.0 * row->cpu_nsec / interval_nsec : 0;
+
+        proc_usage *usage = &row->proc->usage;
+
+        p_fprintf(out, "%3d %3d  %c   %5.1f %8lld %5lu %5lu %8lld %8lld %s\n", row->proc->pid, row->proc->priority,
+                  row->proc->status, cpu, NSEC_TO_TICKS(usage->run_nsec), usage->voluntary_switches,
+                  usage->involuntary_switches, usage->bytes_read, usage->bytes_written, row->proc->cmd);
+    }
+
+    tagged_free(rows);
+    free_process_rows(procs, num_rows);
+}
+
+// top [-n iterations] [-d seconds]: shows the processes by CPU usage every so many seconds (1 by
+// default), until it's interrupted or has refreshed iterations times.
+static void top(int num_args, char *argv[]) {
+    int iterations = -1;
+    double delay = 1;
+
+    for (int i = 1; i < num_args; i += 2) {
+        HANDLE_INVALID_INPUT_VOID(i + 1 == num_args || (strcmp(argv[i], "-n") != 0 && strcmp(argv[i], "-d") != 0),
+                                  "Usage: top [-n iterations] [-d seconds]\n");
+
+        if (strcmp(argv[i], "-n") == 0) {
+            iterations = atoi(argv[i + 1]);
+        } else {
+            delay = atof(argv[i + 1]);
+        }
+    }
+
+    HANDLE_INVALID_INPUT_VOID(iterations == 0 || delay <= 0, "top: iterations and delay must be positive\n");
+
+    file_stream *out = p_stdout();
+    bool console = f_is_console(STDOUT_FILENO);
+
+    top_sample samples[MAX_TOP_SAMPLES];
+    int num_samples = 0;
+    long long last_refresh = -1;
+
+    while (iterations != 0) {
+        long long now = nsec_since_boot();
+
+        // Only the console is cleared, a file gets every refresh.
+        if (console) {
+            p_fprintf(out, "\033[H\033[J");
+        }
+
+        print_top(out, samples, &num_samples, last_refresh < 0 ? 0 : now - last_refresh);
+        last_refresh = now;
+
+        if (p_fflush(out) == -1) {
+            p_perror(NULL);
+            return;
+        }
+
+        if (iterations > 0 && --iterations == 0) {
+            break;
+        }
+
+        p_sleep_ms(delay * 1000);
+    }
+}
+
+// Prints one row of meminfo.
+static void print_mem_usage(file_stream *out, const char *kind, const char *subsystem, mem_usage *usage) {
+    p_fprintf(out, "%-18s %-7s %8lld %8lld %11lld %11lld %9lu\n", kind, subsystem, usage->live_objects,
+              usage->peak_objects, usage->live_bytes, usage->peak_bytes, usage->allocs);
+}
+
+// meminfo: shows the live objects and bytes of each kind of allocation and of each subsystem, and
+// their high-water marks.
+static void meminfo(file_stream *out) {
+    mem_usage usage;
+
+    p_fprintf(out, "%-18s %-7s %8s %8s %11s %11s %9s\n", "KIND", "SUBSYS", "OBJECTS", "PEAK", "BYTES", "PEAK_BYTES",
+              "ALLOCS");
+
+    for (mem_tag tag = 0; tag < NUM_MEM_TAGS; tag++) {
+        get_mem_usage(tag, &usage);
+        print_mem_usage(out, mem_tag_name(tag), mem_subsystem_name(mem_tag_subsystem(tag)), &usage);
+    }
+
+    p_fprintf(out, "\n");
+
+    for (mem_subsystem subsystem = 0; subsystem < NUM_SUBSYSTEMS; subsystem++) {
+        get_subsystem_mem_usage(subsystem, &usage);
+        print_mem_usage(out, "", mem_subsystem_name(subsystem), &usage);
+    }
+
+    get_total_mem_usage(&usage);
+    print_mem_usage(out, "", "total", &usage);
+}
+
 void exit_shell() {
-    swapcontext(get_active_job()->context, get_os_context());
+    shutdown_scheduler();
 }
 
 void zombie_child() {
@@ -63,7 +303,7 @@ bool exec_subroutine(char *argv[]) {
                        "jobs : list all jobs. \n"
                        "logout : exit the shell and shutdown PennOS. \n"
                        "cat : the usual cat from bash.\n"
-                       "sleep x : sleep for x seconds.\n"
+                       "sleep x : sleep for x seconds, e.g. 2 or 0.25.\n"
                        "busy : waits indefinitely\n"
                        "echo : similar to echo(1) in the VM.\n"
                        "ls : list all files in the working directory (similar to ls -il in bash), same formatting as ls in the standalone PennFAT.\n"
@@ -72,10 +312,17 @@ bool exec_subroutine(char *argv[]) {
                        "cp src dest : copy src to dest.\n"
                        "rm file ... : remove files.\n"
                        "chmod : similar to chmod(1) in the VM.\n"
-                       "ps : list all processes on PennOS. Display pid, ppid, and priority.\n"
+                       "ps [-l] : list all processes on PennOS. Display pid, ppid, and priority, and with -l, the ticks each ran, its voluntary and involuntary context switches, ticks blocked and waiting to run, bytes read and written, and FAT blocks allocated.\n"
+                       "top [-n iterations] [-d seconds] : show the load averages and the processes by CPU usage, refreshed every second (or as set with -d) until interrupted.\n"
                        "kill [ -SIGNAL_NAME ] pid ... : send the specified signal to the specified processes, where -SIGNAL_NAME is either term (the default), stop, or cont, corresponding to S_SIGTERM, S_SIGSTOP, and S_SIGCONT, respectively. Similar to /bin/kill in the VM.\n"
+                       "sched [high mid low] : show or set the weights of the high, mid and low priority scheduler queues.\n"
                        "zombify : creates a zombie process.\n"
-                       "orphanify : creates an orphan process.\n";
+                       "orphanify : creates an orphan process.\n"
+                       "schedbench : times moving 1000 busy processes between scheduler queues.\n"
+                       "ctxbench : times context switches with swapcontext and with the fast switch.\n"
+                       "sysstat [pid] : show the count, errors and latency of every system call made, or of those of process pid. Needs PennOS built with -DSYSSTAT.\n"
+                       "profile start|stop|report : start sampling which process runs, and in which function, every tick; stop and report the samples by process and by function; or report them without stopping.\n"
+                       "meminfo : show the live objects and bytes of each kind of allocation (list nodes, PCBs, stacks, ...) and of each subsystem, and their peaks.\n";
         fprintf(stderr, "%s", my_str);
     } else if (strcmp(cmd, "jobs") == 0) {
         linked_list *bg_queue = get_bg_queue();
@@ -102,7 +349,7 @@ bool exec_subroutine(char *argv[]) {
         HANDLE_INVALID_INPUT_RET_VAL(jb == NULL, "bg: specified job does not exist\n", true);
 
         // Change the job status to running.
-        if (p_kill(jb->job_pid, S_SIGCONT) < 0) {
+        if (signal_job(jb, S_SIGCONT) < 0) {
             p_perror("process doesn't exist");
             return true;
         }
@@ -111,32 +358,54 @@ bool exec_subroutine(char *argv[]) {
         job *jb = find_bg_job(argv[1]);
         HANDLE_INVALID_INPUT_RET_VAL(jb == NULL, "fg: specified job does not exist\n", true);
 
-        pcb *proc_pcb = find_pcb_in_table(jb->job_pid);
-        proc_pcb->is_bg = false;
+        for (int i = 0; i < jb->num_pids; i++) {
+            pcb *proc_pcb = jb->pids[i] == FINISHED_PID_VAL ? NULL : find_pcb_in_table(jb->pids[i]);
+
+            if (proc_pcb != NULL) {
+                proc_pcb->is_bg = false;
+            }
+        }
 
         // Was running in bg.
-        if (proc_pcb->status == RUNNING) {
+        if (!job_stopped(jb)) {
             // Job status reporting.
-            fprintf(stderr, "%s\n", proc_pcb->cmd);
+            char cmds[2 * MAX_LINE_LENGTH];
+            job_command(jb, cmds, sizeof(cmds));
+            fprintf(stderr, "%s\n", cmds);
         } else {
             // Was stopped in bg.
-            if (p_kill(jb->job_pid, S_SIGCONT) < 0) {
+            if (signal_job(jb, S_SIGCONT) < 0) {
                 p_perror("Error resuming process in bg");
                 return true;
             }
         }
 
-        // Execute process in fg & wait with blocking
-        update_fg_pid(proc_pcb->pid);
-        int status;
+        // Execute job in fg & wait with blocking
+        update_fg_job(jb);
 
-        pid_t ret_pid = p_waitpid(jb->job_pid, &status, false);
-        if (W_WIFEXITED(status) || W_WIFSIGNALED(status)) {
+        // The signal handler can't reach the job anymore once it's out of the foreground.
+        bool finished = wait_for_job(jb);
+        update_fg_job(NULL);
+
+        if (finished) {
             // remove job from background queue if job terminated/exited
-            remove_bg_job(ret_pid);
+            remove_bg_job(jb->job_pid);
             free_job(jb);
         }
 
+        return true;
+    } else if (strcmp(cmd, "sched") == 0) {
+        // sched [high mid low] show or set the weights of the scheduler queues.
+        HANDLE_INVALID_INPUT_RET_VAL(num_args != 1 && num_args != 4, "sched: Incorrect number of arguments\n", true);
+
+        if (num_args == 4 && p_set_sched_weights(atoi(argv[1]), atoi(argv[2]), atoi(argv[3])) == -1) {
+            p_perror(NULL);
+            return true;
+        }
+
+        int weights[3];
+        get_scheduler_weights(weights);
+        fprintf(stderr, "high %d mid %d low %d\n", weights[0], weights[1], weights[2]);
         return true;
     } else if (strcmp(cmd, "kill") == 0) {
         //  kill [ -SIGNAL_NAME ] pid ... (S*) send the specified signal to the specified processes
@@ -249,31 +518,17 @@ void exec_command(char *argv[]) {
     } else if (strcmp(cmd, "cp") == 0) {
         HANDLE_INVALID_INPUT_VOID(num_args != 3, "cp: Incorrect number of arguments");
 
-        char buf[MAX_LINE_LENGTH];
         int src = f_open(argv[1], F_READ);
         if (src == -1) {
             p_perror(NULL);
         }
 
-        int dst = f_open(argv[2], F_WRITE);
+        int dst = f_open(argv[2], F_OVERWRITE);
         if (dst == -1) {
             p_perror(NULL);
         }
 
-        while (true) {
-            int bytes_read = f_read(src, MAX_LINE_LENGTH, buf);
-            if (bytes_read == -1) {
-                p_perror(NULL);
-            }
-
-            if (f_write(dst, buf, bytes_read) == -1) {
-                p_perror(NULL);
-            }
-
-            if (bytes_read < MAX_LINE_LENGTH) {
-                break;
-            }
-        }
+        splice_all(src, dst);
 
         if (f_close(src) == -1) {
             p_perror(NULL);
@@ -284,22 +539,7 @@ void exec_command(char *argv[]) {
         }
     } else if (strcmp(cmd, "cat") == 0) {
         if (num_args == 1) {
-            char buf[MAX_LINE_LENGTH] = {'\0'};
-
-            while (true) {
-                int bytes_read = f_read(STDIN_FILENO, MAX_LINE_LENGTH, buf);
-                if (bytes_read == -1) {
-                    p_perror(NULL);
-                }
-
-                if (bytes_read <= 0) {
-                    break;
-                }
-
-                if (f_write(STDOUT_FILENO, buf, bytes_read) == -1) {
-                    p_perror(NULL);
-                }
-            }
+            splice_all(STDIN_FILENO, STDOUT_FILENO);
         } else {
             for (int i = 1; i < num_args; i++) {
                 int src = f_open(argv[i], F_READ);
@@ -309,22 +549,7 @@ void exec_command(char *argv[]) {
                     continue;
                 }
 
-                while (true) {
-                    char buf[MAX_LINE_LENGTH] = {'\0'};
-
-                    int bytes_read = f_read(src, MAX_LINE_LENGTH, buf);
-                    if (bytes_read == -1) {
-                        p_perror(NULL);
-                    }
-
-                    if (f_write(STDOUT_FILENO, buf, bytes_read) == -1) {
-                        p_perror(NULL);
-                    }
-
-                    if (bytes_read < MAX_LINE_LENGTH) {
-                        break;
-                    }
-                }
+                splice_all(src, STDOUT_FILENO);
 
                 if (f_close(src) == -1) {
                     p_perror(NULL);
@@ -333,55 +558,70 @@ void exec_command(char *argv[]) {
         }
     } else if (strcmp(cmd, "sleep") == 0) {
         if (num_args == 2) {
-            p_sleep(SECONDS_TO_TICKS(atoi(argv[1])));
+            p_sleep_ms(atof(argv[1]) * 1000);
         } else {
             fprintf(stderr, "sleep: incorrect number of arguments\n");
         }
     } else if (strcmp(cmd, "busy") == 0) {
         while (true) {}
     } else if (strcmp(cmd, "echo") == 0) {
+        file_stream *out = p_stdout();
+
         for (int i = 1; i < num_args; i++) {
             if (i != 1) {
-                if (f_write(STDOUT_FILENO, " ", 1) == -1) {
+                if (p_fwrite(out, " ", 1) == -1) {
                     p_perror(NULL);
                 }
             }
 
-            if (f_write(STDOUT_FILENO, argv[i], strlen(argv[i])) == -1) {
+            if (p_fwrite(out, argv[i], strlen(argv[i])) == -1) {
                 p_perror(NULL);
             }
         }
 
-        if (f_write(STDOUT_FILENO, "\n", 1) == -1) {
+        if (p_fwrite(out, "\n", 1) == -1) {
             p_perror(NULL);
         }
     } else if (strcmp(cmd, "ps") == 0) {
-        linked_list *pctb = get_process_table();
+        int num_rows;
+        proc_row *rows = copy_processes(&num_rows);
 
-        if (pctb->size == 0) {
+        if (num_rows == 0) {
             fprintf(stderr, "no processes to display/n");
         } else {
-            linked_list_elem *curr = pctb->head;
-            char str[4096] = {'\0'}; // way more than necessary
-            char *format = "PID PPID PRI STAT CMD\n";
-            if (f_write(STDOUT_FILENO, format, strlen(format)) == -1) {
+            file_stream *out = p_stdout();
+            bool long_format = num_args > 1 && strcmp(argv[1], "-l") == 0;
+            const char *header = long_format ? "PID PPID PRI STAT    TICKS  VCSW IVCSW  BLOCKED  WAITING     READ  WRITTEN BLOCKS CMD\n"
+                                             : "PID PPID PRI STAT CMD\n";
+            if (p_fprintf(out, "%s", header) == -1) {
                 p_perror(NULL);
             }
 
-            while (curr != NULL) {
-                pcb *curr_pcb = curr->val;
-                char status =
-                        curr_pcb->blocked && curr_pcb->status == RUNNING ? 'B' : get_status_code(curr_pcb->status);
-                int ppid = curr_pcb->parent != NULL ? curr_pcb->parent->pid : 0;
-                sprintf(str, "%3d %4d %3d  %c   %s\n", curr_pcb->pid, ppid, curr_pcb->priority, status, curr_pcb->cmd);
+            for (int i = 0; i < num_rows; i++) {
+                proc_row *row = &rows[i];
+                proc_usage *usage = &row->usage;
+                int result;
+
+                if (long_format) {
+                    result = p_fprintf(out, "%3d %4d %3d  %c   %8lld %5lu %5lu %8lld %8lld %8lld %8lld %6lu %s\n",
+                                       row->pid, row->ppid, row->priority, row->status, NSEC_TO_TICKS(usage->run_nsec),
+                                       usage->voluntary_switches, usage->involuntary_switches,
+                                       NSEC_TO_TICKS(usage->blocked_nsec), NSEC_TO_TICKS(usage->wait_nsec),
+                                       usage->bytes_read, usage->bytes_written, usage->blocks_allocated, row->cmd);
+                } else {
+                    result = p_fprintf(out, "%3d %4d %3d  %c   %s\n", row->pid, row->ppid, row->priority, row->status,
+                                       row->cmd);
+                }
 
-                if (f_write(STDOUT_FILENO, str, strlen(str)) == -1) {
+                if (result == -1) {
                     p_perror(NULL);
                 }
-
-                curr = curr->next;
             }
         }
+
+        free_process_rows(rows, num_rows);
+    } else if (strcmp(cmd, "top") == 0) {
+        top(num_args, argv);
     } else if (strcmp(cmd, "zombify") == 0) {
         zombify();
     } else if (strcmp(cmd, "orphanify") == 0) {
@@ -392,6 +632,54 @@ void exec_command(char *argv[]) {
         nohang();
     } else if (strcmp(cmd, "recur") == 0) {
         recur();
+    } else if (strcmp(cmd, "schedbench") == 0) {
+        sched_bench();
+    } else if (strcmp(cmd, "ctxbench") == 0) {
+        ctx_bench();
+    } else if (strcmp(cmd, "sysstat") == 0) {
+#ifdef SYSSTAT
+        HANDLE_INVALID_INPUT_VOID(num_args > 2, "Usage: sysstat [pid]\n");
+
+        // Formatted in memory, so it's written through the process's stdout.
+        char *report = NULL;
+        size_t len = 0;
+        FILE *mem = open_memstream(&report, &len);
+        HANDLE_SYS_CALL(mem == NULL, "open_memstream");
+
+        {
+            // Keeps the other cores from changing the table while walking it.
+            SYSTEM_CALL();
+
+            if (print_syscall_stats(mem, num_args == 2 ? atoi(argv[1]) : -1) == -1) {
+                fprintf(stderr, "sysstat: no process %s\n", argv[1]);
+            }
+        }
+
+        fclose(mem);
+
+        file_stream *out = p_stdout();
+        if (p_fwrite(out, report, len) == -1) {
+            p_perror(NULL);
+        }
+
+        free(report);
+#else
+        fprintf(stderr, "sysstat: PennOS was built without -DSYSSTAT\n");
+#endif
+    } else if (strcmp(cmd, "meminfo") == 0) {
+        meminfo(p_stdout());
+    } else if (strcmp(cmd, "profile") == 0) {
+        HANDLE_INVALID_INPUT_VOID(num_args != 2 || (strcmp(argv[1], "start") != 0 && strcmp(argv[1], "stop") != 0 &&
+                                                    strcmp(argv[1], "report") != 0),
+                                  "Usage: profile start|stop|report\n");
+
+        if (strcmp(argv[1], "report") != 0) {
+            p_profile(strcmp(argv[1], "start") == 0);
+        }
+
+        if (strcmp(argv[1], "start") != 0) {
+            print_profile(p_stdout());
+        }
     } else {
         int script_size = f_size(argv[0]);
 
@@ -400,27 +688,23 @@ void exec_command(char *argv[]) {
         } else if (!f_has_permissions(argv[0], EXEC_ONLY)) {
             fprintf(stderr, "File %s is not executable\n", argv[0]);
         } else {
-            int script_fd = f_open(argv[0], F_READ);
-            if (script_fd == -1) {
+            file_stream *script = p_fopen(argv[0], F_READ);
+            if (script == NULL) {
                 p_perror(NULL);
-            }
+            } else {
+                char line[MAX_LINE_LENGTH];
 
-            char buf[script_size + 1];
-            buf[script_size] = '\0';
+                while (p_fgets(line, MAX_LINE_LENGTH, script) != NULL) {
+                    line[strcspn(line, "\n")] = '\0';
 
-            if (f_read(script_fd, script_size, buf) == -1) {
-                p_perror(NULL);
-            }
-
-            const char *delim = "\n";
-            char *line = strtok(buf, delim);
-            while (line != NULL) {
-                handle_input(line, 0);
-                line = strtok(NULL, delim);
-            }
+                    if (line[0] != '\0') {
+                        handle_input(line, 0);
+                    }
+                }
 
-            if (f_close(script_fd) == -1) {
-                p_perror(NULL);
+                if (p_fclose(script) == -1) {
+                    p_perror(NULL);
+                }
             }
         }
     }
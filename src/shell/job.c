@@ -8,20 +8,38 @@
 #include <sys/types.h>
 #include "shell.h"
 #include "../kernel/pcb_table.h"
+#include "../lib/tagged_alloc.h"
 
-job *create_job(pid_t pid) {
-    job *jb = (job *) malloc(sizeof(job));
+job *create_job(pid_t *pids, int num_pids) {
+    job *jb = (job *) tagged_malloc(MEM_JOBS, sizeof(job));
     if (jb == NULL) {
         return NULL;
         perror("malloc");
     }
-    jb->job_pid = pid;
+    jb->pids = (pid_t *) tagged_malloc(MEM_JOBS, num_pids * sizeof(pid_t));
+    memcpy(jb->pids, pids, num_pids * sizeof(pid_t));
+    jb->num_pids = num_pids;
+    jb->job_pid = pids[num_pids - 1];
     jb->job_id = min_available_id();
     return jb;
 }
 
 void free_job(void *j) {
-    free(j);
+    job *jb = (job *) j;
+    tagged_free(jb->pids);
+    tagged_free(jb);
+}
+
+bool job_stopped(job *j) {
+    for (int i = 0; i < j->num_pids; i++) {
+        pcb *proc = j->pids[i] == FINISHED_PID_VAL ? NULL : find_pcb_in_table(j->pids[i]);
+
+        if (proc != NULL && proc->status == STOPPED) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 bool job_equal_predicate(void *target_pid, void *curr_job) {
@@ -37,18 +55,29 @@ bool job_id_equal_predicate(void *target_job_id, void *curr_job) {
 }
 
 
-void print_job(job *j) {
-    pcb *proc = find_pcb_in_table(j->job_pid);
+void job_command(job *j, char *buf, size_t size) {
+    buf[0] = '\0';
 
-    char *status_msg = NULL;
+    for (int i = 0; i < j->num_pids; i++) {
+        pcb *proc = j->pids[i] == FINISHED_PID_VAL ? NULL : find_pcb_in_table(j->pids[i]);
 
-    if (proc->status == STOPPED || proc->status == RUNNING) {
-        if (proc->status == STOPPED) {
-            status_msg = "stopped";
-        } else if (proc->status == RUNNING) {
-            status_msg = "running";
+        if (proc == NULL || (proc->status != STOPPED && proc->status != RUNNING)) {
+            continue;
         }
 
-        fprintf(stderr, "[%d] %d: %s (%s)\n", j->job_id, proc->pid, proc->cmd, status_msg);
+        if (buf[0] != '\0') {
+            strncat(buf, " | ", size - strlen(buf) - 1);
+        }
+
+        strncat(buf, proc->cmd, size - strlen(buf) - 1);
+    }
+}
+
+void print_job(job *j) {
+    char cmds[2 * MAX_LINE_LENGTH];
+    job_command(j, cmds, sizeof(cmds));
+
+    if (cmds[0] != '\0') {
+        fprintf(stderr, "[%d] %d: %s (%s)\n", j->job_id, j->job_pid, cmds, job_stopped(j) ? "stopped" : "running");
     }
 }
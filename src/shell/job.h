@@ -3,13 +3,18 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/types.h>
 
 // Placeholder value for the PID of a process that has already finished.
 #define FINISHED_PID_VAL -1
 
 typedef struct job_st {
-    // pid of corresponding process pcb 
+    // pids of the job's processes, one per pipeline stage. FINISHED_PID_VAL once it's been waited for.
+    pid_t *pids;
+    int num_pids;
+
+    // pid of the last stage, which the job goes by.
     pid_t job_pid;
 
     // Job index to print in jobs built in command.
@@ -18,16 +23,23 @@ typedef struct job_st {
 
 // Creates a job object from the specified details. Uses malloc
 // to dynamically allocate space for PIDs array and command string.
-job *create_job(pid_t pid);
+job *create_job(pid_t *pids, int num_pids);
 
 // Frees the dynamically allocated pointers in the specified job.
 void free_job(void *j);
 
+// Returns true if any process of the job is stopped.
+bool job_stopped(job *j);
+
 // Used to find a job in a linked list with a given pid.
 bool job_equal_predicate(void *target_pid, void *curr_job);
 
 // Used to find a job in a linked list with a given job id.
 bool job_id_equal_predicate(void *target_job_id, void *curr_job);
 
+// Stores the commands of the job's stages that are still running or stopped in buf, which holds
+// size bytes, separated by pipes as in the command line.
+void job_command(job *j, char *buf, size_t size);
+
 // Prints a job to console for debugging.
 void print_job(job *j);
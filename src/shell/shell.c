@@ -24,17 +24,29 @@
 #include "../user/process_user_funcs.h"
 #include "../user/file_user_funcs.h"
 
-// Represents if there is a current command running.
-pid_t foreground_pid = NO_ACTIVE_PROCESS;
+// The job running in the foreground, if any.
+job *foreground_job = NULL;
 bool interactive_mode = false;
 
 // Queue of jobs.
 linked_list background_jobs;
 
-// Return true if the child terminated normally, that is, by a call to p_exit
-// or by returning.
-void update_fg_pid(pid_t pid) {
-    foreground_pid = pid;
+void update_fg_job(job *jb) {
+    // The signal handler reads the foreground job in the kernel, see sig_handler().
+    SYSTEM_CALL();
+    foreground_job = jb;
+}
+
+int signal_job(job *jb, int sig) {
+    int result = 0;
+
+    for (int i = 0; i < jb->num_pids; i++) {
+        if (jb->pids[i] != FINISHED_PID_VAL && p_kill(jb->pids[i], sig) == -1) {
+            result = -1;
+        }
+    }
+
+    return result;
 }
 
 void sig_handler(int signo) {
@@ -42,41 +54,40 @@ void sig_handler(int signo) {
         // Pass terminal control back to Penn Shell.
         f_write(STDERR_FILENO, "\n", 1);
 
-        if (foreground_pid == NO_ACTIVE_PROCESS) {
+        if (foreground_job == NULL) {
             f_write(STDERR_FILENO, PROMPT, sizeof(PROMPT));
         }
     }
 
-    if (foreground_pid != NO_ACTIVE_PROCESS) {
-        if (signo == SIGINT) {
-            int result = p_kill(foreground_pid, S_SIGTERM);
-            if (result == -1) {
-                p_perror("p_kill did not work, could not terminate the process\n");
-            }
-
-            update_fg_pid(NO_ACTIVE_PROCESS);
-            suspend();
-        } else if (signo == SIGTSTP) {
-            // Ctrl+Z (stop process).
-
-            int result = p_kill(foreground_pid, S_SIGSTOP);
-            if (result == -1) {
-                p_perror("p_kill did not work, could not stop the process\n");
-            }
-
-            // If fg process is stopped, move it to bg
-            pcb *proc = find_pcb_in_table(foreground_pid);
-            proc->is_bg = true;
+    if (signo != SIGINT && signo != SIGTSTP) {
+        return;
+    }
 
-            // Only add job to queue if it's not already there
-            if (!elem_exists(&background_jobs, job_equal_predicate, &foreground_pid)) {
-                job *jb = create_job(proc->pid);
-                push_back(&background_jobs, jb);
-            }
+    bool signaled = false;
+    int result = 0;
+
+    {
+        // With several cores, the shell can run while this handler does, and reap and free the
+        // foreground job. It takes the job out of the foreground in the kernel first, and p_kill()
+        // doesn't leave the kernel, so the job stays valid until it's been signaled.
+        SYSTEM_CALL();
+
+        if (foreground_job != NULL) {
+            // Ctrl+C terminates the job, Ctrl+Z stops it, and the shell moves it to the background
+            // once it sees it stopped.
+            result = signal_job(foreground_job, signo == SIGINT ? S_SIGTERM : S_SIGSTOP);
+            foreground_job = NULL;
+            signaled = true;
+        }
+    }
 
-            update_fg_pid(NO_ACTIVE_PROCESS);
-            suspend();
+    if (signaled) {
+        if (result == -1) {
+            p_perror(signo == SIGINT ? "p_kill did not work, could not terminate the process\n"
+                                     : "p_kill did not work, could not stop the process\n");
         }
+
+        suspend();
     }
 }
 
@@ -112,13 +123,27 @@ void refresh_bg_jobs() {
         while (cur != NULL) {
             linked_list_elem *next_node = cur->next;
             job *jb = (job *) cur->val;
-            pid_t ret_pid = p_waitpid(jb->job_pid, &status, true); // nohang = true;
+            bool finished = true;
+
+            for (int i = 0; i < jb->num_pids; i++) {
+                if (jb->pids[i] == FINISHED_PID_VAL) {
+                    continue;
+                }
+
+                pid_t ret_pid = p_waitpid(jb->pids[i], &status, true); // nohang = true;
 
-            // Only cleanup if process was exited or terminated.
-            if (W_WIFEXITED(status) || W_WIFSIGNALED(status)) {
-                // Free job struct if waitpid cleans up the pcb.
-                remove_bg_job(ret_pid);
-                free(jb);
+                // Only cleanup if process was exited or terminated.
+                if (ret_pid == -1 || W_WIFEXITED(status) || W_WIFSIGNALED(status)) {
+                    jb->pids[i] = FINISHED_PID_VAL;
+                } else {
+                    finished = false;
+                }
+            }
+
+            // Free job struct once waitpid cleaned up every pcb.
+            if (finished) {
+                remove_bg_job(jb->job_pid);
+                free_job(jb);
             }
 
             cur = next_node;
@@ -126,6 +151,42 @@ void refresh_bg_jobs() {
     }
 }
 
+bool wait_for_job(job *jb) {
+    for (int i = 0; i < jb->num_pids; i++) {
+        if (jb->pids[i] == FINISHED_PID_VAL) {
+            continue;
+        }
+
+        int status;
+        bool nohang = false;
+
+        pid_t result = p_waitpid(jb->pids[i], &status, nohang);
+        if (result == -1) {
+            p_perror("p_waitpid failed\n");
+        } else if (W_WIFSTOPPED(status)) {
+            // If fg job is stopped, move it to bg
+            for (int j = 0; j < jb->num_pids; j++) {
+                pcb *proc = jb->pids[j] == FINISHED_PID_VAL ? NULL : find_pcb_in_table(jb->pids[j]);
+
+                if (proc != NULL) {
+                    proc->is_bg = true;
+                }
+            }
+
+            // Only add job to queue if it's not already there
+            if (!elem_exists(&background_jobs, job_equal_predicate, &jb->job_pid)) {
+                push_back(&background_jobs, jb);
+            }
+
+            return false;
+        }
+
+        jb->pids[i] = FINISHED_PID_VAL;
+    }
+
+    return true;
+}
+
 void handle_input(char *input, int priority) {
     struct parsed_command *command;
     int err = parse_command(input, &command);
@@ -187,8 +248,11 @@ void handle_input(char *input, int priority) {
         return;
     }
 
-    if (!exec_subroutine(command->commands[0])) {
+    // Only a single command can be a shell subroutine, the stages of a pipeline are processes.
+    if (command->num_commands > 1 || !exec_subroutine(command->commands[0])) {
         pcb *active_job = get_active_job();
+        int num_stages = command->num_commands;
+
         int fd0 = active_job->fd[0];
         if (command->stdin_file != NULL) {
             fd0 = f_open(command->stdin_file, F_READ);
@@ -202,7 +266,7 @@ void handle_input(char *input, int priority) {
 
         int fd1 = active_job->fd[1];
         if (command->stdout_file) {
-            fd1 = f_open(command->stdout_file, (command->is_file_append ? F_APPEND : F_WRITE));
+            fd1 = f_open(command->stdout_file, (command->is_file_append ? F_APPEND : F_OVERWRITE));
 
             if (fd1 < 0) {
                 p_perror("Opening fd1 redirect\n");
@@ -211,12 +275,40 @@ void handle_input(char *input, int priority) {
             }
         }
 
-        pid_t child = p_spawn(&exec_command, command->commands[0], fd0, fd1, priority);
-        if (child == -1) {
-            p_perror("p_spawn did not work\n");
+        // Stage i writes into pipes[i], which stage i + 1 reads from.
+        int pipes[num_stages][2];
+        int num_pipes = 0;
+
+        for (; num_pipes < num_stages - 1; num_pipes++) {
+            if (p_pipe(pipes[num_pipes]) == -1) {
+                p_perror("p_pipe did not work\n");
+                break;
+            }
+        }
+
+        // All the stages run at once, as one job.
+        pid_t pids[num_stages];
+        int num_pids = 0;
+
+        if (num_pipes == num_stages - 1) {
+            for (int i = 0; i < num_stages; i++) {
+                int stage_fd0 = i == 0 ? fd0 : pipes[i - 1][0];
+                int stage_fd1 = i == num_stages - 1 ? fd1 : pipes[i][1];
+
+                pid_t child = p_spawn(&exec_command, command->commands[i], stage_fd0, stage_fd1, priority);
+                if (child == -1) {
+                    p_perror("p_spawn did not work\n");
+                } else {
+                    pids[num_pids++] = child;
+                }
+            }
         }
 
-        foreground_pid = child;
+        // The stages hold their own references to the pipe ends and redirected files.
+        for (int i = 0; i < num_pipes; i++) {
+            f_close(pipes[i][0]);
+            f_close(pipes[i][1]);
+        }
 
         if (fd0 > STDERR_FILENO && fd0 != active_job->fd[0]) {
             f_close(fd0);
@@ -226,34 +318,54 @@ void handle_input(char *input, int priority) {
             f_close(fd1);
         }
 
-        // Check if process is in the background
-        if (command->is_background) {
-            pcb *child_process = find_pcb_in_table(child);
-            child_process->is_bg = true;
-            job *child_job = create_job(child_process->pid);
-            push_back(&background_jobs, child_job);
-            // Job status report
-            fprintf(stderr, "Running: %s\n", child_process->cmd);
-        } else {
-            // Process is in foreground.
-
-            int status;
-            bool nohang = false;
-
-            pid_t result = p_waitpid(child, &status, nohang);
-            if (result == -1) {
-                p_perror("p_waitpid failed\n");
+        if (num_pids > 0) {
+            job *jb = create_job(pids, num_pids);
+
+            // Check if job is in the background
+            if (command->is_background) {
+                for (int i = 0; i < num_pids; i++) {
+                    pcb *proc = find_pcb_in_table(pids[i]);
+
+                    if (proc != NULL) {
+                        proc->is_bg = true;
+                    }
+                }
+
+                push_back(&background_jobs, jb);
+
+                // Job status report
+                char cmds[2 * MAX_LINE_LENGTH];
+                job_command(jb, cmds, sizeof(cmds));
+                fprintf(stderr, "Running: %s\n", cmds);
+            } else {
+                // Job is in foreground.
+                update_fg_job(jb);
+
+                // A stopped job was moved to the background jobs. The signal handler can't reach
+                // the job anymore once it's out of the foreground.
+                bool finished = wait_for_job(jb);
+                update_fg_job(NULL);
+
+                if (finished) {
+                    free_job(jb);
+                }
             }
         }
     }
 
-    foreground_pid = NO_ACTIVE_PROCESS;
+    update_fg_job(NULL);
     free(command);
 }
 
 void main_shell(void) {
     init_linked_list(&background_jobs);
 
+    // Writes the scheduler log in the background, whenever nothing more important runs.
+    char *logger_argv[2] = {"logger", NULL};
+    if (p_spawn(log_writer, logger_argv, STDIN_FILENO, STDOUT_FILENO, 1) == -1) {
+        p_perror("p_spawn did not work\n");
+    }
+
     int num_bytes;
 
     while (1) {
@@ -308,9 +420,8 @@ job *get_current_job(linked_list *linked_list) {
 
         while (cur_elem != NULL) {
             job *cur_job = (job *) cur_elem->val;
-            pcb *cur_pcb = find_pcb_in_table(cur_job->job_pid);
 
-            if (cur_pcb->status == STOPPED) {
+            if (job_stopped(cur_job)) {
                 return cur_job;
             }
 
@@ -16,8 +16,6 @@
 #include "../lib/pcb.h"
 #include "job.h"
 
-#define NO_ACTIVE_PROCESS -1
-
 // Used to find a PCB with a specified PID.
 bool pid_equal_predicate(void *pid, void *target_pcb);
 
@@ -46,8 +44,16 @@ int min_available_id();
 // Removes a background job with the specified pid.
 void remove_bg_job(pid_t job_pid);
 
-// Updates the foreground PID of the shell.
-void update_fg_pid(pid_t pid);
+// Updates the foreground job of the shell. NULL if there is none.
+void update_fg_job(job *jb);
+
+// Sends sig to every process of the job that hasn't finished. Returns -1 if any of them couldn't
+// be signaled, otherwise 0.
+int signal_job(job *jb, int sig);
+
+// Waits for every process of the foreground job to finish. If one stops instead, the job is moved
+// to the background jobs, and this returns false.
+bool wait_for_job(job *jb);
 
 // Returns the background queue.
 linked_list *get_bg_queue();
@@ -0,0 +1,587 @@
+// Main file for pennos-trace, which analyzes a PennOS scheduler log.
+// It replays the events to follow which process runs and which ones wait in the run queues, and
+// reports the CPU share of each priority class, how long processes waited to run (from the run
+// queue, and after waking up), processes that starved, and whether the dispatch ratio of the
+// classes matches their weights. The log has no core numbers, so it's read as if PennOS ran on
+// one core.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../kernel/pcb_table.h"
+#include "../lib/macros.h"
+
+#define DEFAULT_LOG_NAME "log/scheduler.log"
+
+// Longest log line read whole. Longer command names are cut.
+#define LINE_SIZE 4096
+
+#define USAGE "Usage: ./pennos-trace [schedLog] [--weights=H:M:L] [--starve=TICKS] [--top=N]\n"
+
+// Number of priority classes. A priority's class is its index priority + 1.
+#define NUM_CLASSES 3
+
+// A process waiting longer than this to run is reported as starved, unless set with --starve.
+#define DEFAULT_STARVE_TICKS 1000
+
+// Number of processes listed per class, unless set with --top.
+#define DEFAULT_TOP 10
+
+// Starvation incidents listed in the report. Only the number of the others is reported.
+#define MAX_LISTED_INCIDENTS 20
+
+// Largest difference between the observed and the expected share of a class's dispatches, in
+// percentage points, for the ratio to match.
+#define RATIO_TOLERANCE 2.0
+
+// Histogram buckets: 0, 1, 2-3, 4-7, ... ticks, the last one holding everything longer.
+#define NUM_BUCKETS 12
+
+static const char *class_names[NUM_CLASSES] = {"high", "mid", "low"};
+
+typedef struct proc_stats_st {
+    pid_t pid;
+    char *cmd;
+    int priority;
+
+    // State as of the last event replayed.
+    bool alive;
+    bool blocked;
+    bool stopped;
+
+    // Whether the process waits in a run queue, and since when.
+    bool runnable;
+    unsigned int runnable_since;
+
+    // Whether the process was woken up and hasn't run since, and when that was.
+    bool woken;
+    unsigned int woken_at;
+
+    unsigned long long ticks_run;
+    unsigned long dispatches;
+} proc_stats;
+
+// Growable array of durations in ticks.
+typedef struct samples_st {
+    unsigned int *vals;
+    size_t count;
+    size_t capacity;
+} samples;
+
+typedef struct incident_st {
+    unsigned int tick;
+    proc_stats *proc;
+    int priority;
+    unsigned int wait;
+} incident;
+
+static int weights[NUM_CLASSES] = {HIGH_PRIORITY_WEIGHT, MID_PRIORITY_WEIGHT, LOW_PRIORITY_WEIGHT};
+static unsigned int starve_ticks = DEFAULT_STARVE_TICKS;
+static int top = DEFAULT_TOP;
+
+// Every process in the log, and the one each pid currently belongs to.
+static proc_stats **procs = NULL;
+static size_t num_procs = 0;
+static proc_stats *by_pid[MAX_PID];
+
+// The running process, and since when it runs.
+static proc_stats *running = NULL;
+static unsigned int run_start = 0;
+
+static unsigned long long class_ticks[NUM_CLASSES];
+static unsigned long class_dispatches[NUM_CLASSES];
+static int class_runnable[NUM_CLASSES];
+
+// Dispatches made while all three classes had runnable processes.
+static unsigned long contended_dispatches[NUM_CLASSES];
+
+static samples queue_waits[NUM_CLASSES];
+static samples wake_latencies[NUM_CLASSES];
+
+static incident incidents[MAX_LISTED_INCIDENTS];
+static int num_incidents = 0;
+
+static unsigned int first_tick = 0;
+static unsigned int last_tick = 0;
+static unsigned long num_events = 0;
+
+static void add_sample(samples *s, unsigned int val) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity == 0 ? 1024 : 2 * s->capacity;
+        s->vals = realloc(s->vals, s->capacity * sizeof(unsigned int));
+        HANDLE_SYS_CALL(s->vals == NULL, "realloc");
+    }
+
+    s->vals[s->count++] = val;
+}
+
+static int compare_uints(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+// Returns the nearest-rank q-quantile of the sorted samples.
+static unsigned int quantile(samples *s, double q) {
+    size_t rank = (size_t) (q * s->count + 0.999999);
+    return s->vals[rank == 0 ? 0 : rank - 1];
+}
+
+static int bucket_of(unsigned int ticks) {
+    int bucket = 0;
+
+    while (ticks > 0 && bucket < NUM_BUCKETS - 1) {
+        ticks >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static int class_of(int priority) {
+    return MIN(MAX(priority + 1, 0), NUM_CLASSES - 1);
+}
+
+// Starts tracking a new process with the pid.
+static proc_stats *new_proc(pid_t pid, int priority, const char *cmd) {
+    proc_stats *p = calloc(1, sizeof(proc_stats));
+    HANDLE_SYS_CALL(p == NULL, "calloc");
+
+    p->pid = pid;
+    p->cmd = strdup(cmd);
+    p->priority = priority;
+    p->alive = true;
+
+    procs = realloc(procs, (num_procs + 1) * sizeof(proc_stats *));
+    HANDLE_SYS_CALL(procs == NULL, "realloc");
+    procs[num_procs++] = p;
+
+    by_pid[pid] = p;
+    return p;
+}
+
+// Counts a starved wait of p, which ended (or was still going on) at tick.
+static void add_incident(proc_stats *p, unsigned int tick, unsigned int wait) {
+    if (num_incidents < MAX_LISTED_INCIDENTS) {
+        incidents[num_incidents] = (incident) {.tick = tick, .proc = p, .priority = p->priority, .wait = wait};
+    }
+
+    num_incidents++;
+}
+
+// Brings whether p waits in a run queue up to date with its state.
+static void update_runnable(proc_stats *p, unsigned int tick) {
+    bool runnable = p->alive && !p->blocked && !p->stopped && p != running;
+
+    if (runnable && !p->runnable) {
+        p->runnable_since = tick;
+        class_runnable[class_of(p->priority)]++;
+    } else if (!runnable && p->runnable) {
+        class_runnable[class_of(p->priority)]--;
+    }
+
+    p->runnable = runnable;
+}
+
+// Ends the run of the running process at tick.
+static void end_run(unsigned int tick) {
+    proc_stats *p = running;
+
+    if (p == NULL) {
+        return;
+    }
+
+    p->ticks_run += tick - run_start;
+    class_ticks[class_of(p->priority)] += tick - run_start;
+
+    running = NULL;
+    update_runnable(p, tick);
+}
+
+static void schedule(proc_stats *p, unsigned int tick) {
+    end_run(tick);
+
+    // The process that's picked was waiting too.
+    bool contended = true;
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        if (class_runnable[i] == 0 && !(class_of(p->priority) == i && !p->runnable)) {
+            contended = false;
+        }
+    }
+
+    int class = class_of(p->priority);
+
+    if (p->runnable) {
+        unsigned int wait = tick - p->runnable_since;
+        add_sample(&queue_waits[class], wait);
+
+        if (wait > starve_ticks) {
+            add_incident(p, tick, wait);
+        }
+    }
+
+    if (p->woken) {
+        add_sample(&wake_latencies[class], tick - p->woken_at);
+        p->woken = false;
+    }
+
+    p->dispatches++;
+    class_dispatches[class]++;
+
+    if (contended) {
+        contended_dispatches[class]++;
+    }
+
+    running = p;
+    run_start = tick;
+    update_runnable(p, tick);
+}
+
+// Replays one line of the log. Returns false if it isn't an event.
+static bool replay(char *line) {
+    unsigned int tick;
+    char evt[16];
+    int pid;
+    int priority;
+    int name_start = 0;
+
+    if (sscanf(line, "[%u] %15s %d %d %n", &tick, evt, &pid, &priority, &name_start) < 4 || pid < 0 ||
+        pid >= MAX_PID) {
+        return false;
+    }
+
+    char *cmd = line + name_start;
+    cmd[strcspn(cmd, "\n")] = '\0';
+
+    if (num_events++ == 0) {
+        first_tick = tick;
+    }
+
+    last_tick = tick;
+
+    // NICE lines hold the old and the new priority.
+    int new_priority = priority;
+
+    if (strcmp(evt, "NICE") == 0) {
+        if (sscanf(cmd, "%d %n", &new_priority, &name_start) < 1) {
+            return false;
+        }
+
+        cmd += name_start;
+    }
+
+    proc_stats *p = by_pid[pid];
+
+    // Processes created before the log starts, like the shell, show up at their first event.
+    if (strcmp(evt, "CREATE") == 0 || p == NULL) {
+        p = new_proc(pid, priority, cmd);
+
+        if (strcmp(evt, "CREATE") == 0) {
+            update_runnable(p, tick);
+            return true;
+        }
+    }
+
+    if (strcmp(evt, "SCHEDULE") == 0) {
+        schedule(p, tick);
+    } else if (strcmp(evt, "BLOCKED") == 0) {
+        p->blocked = true;
+        p->woken = false;
+
+        if (p == running) {
+            end_run(tick);
+        }
+    } else if (strcmp(evt, "UNBLOCKED") == 0) {
+        p->blocked = false;
+
+        if (!p->stopped) {
+            p->woken = true;
+            p->woken_at = tick;
+        }
+    } else if (strcmp(evt, "STOPPED") == 0) {
+        p->stopped = true;
+        p->woken = false;
+
+        if (p == running) {
+            end_run(tick);
+        }
+    } else if (strcmp(evt, "CONTINUED") == 0) {
+        p->stopped = false;
+    } else if (strcmp(evt, "EXITED") == 0 || strcmp(evt, "ZOMBIE") == 0 || strcmp(evt, "ORPHAN") == 0) {
+        if (p == running) {
+            end_run(tick);
+        }
+
+        p->alive = false;
+    } else if (strcmp(evt, "NICE") == 0) {
+        // The process moves to the new class's queue.
+        if (p->runnable) {
+            class_runnable[class_of(p->priority)]--;
+            class_runnable[class_of(new_priority)]++;
+        }
+
+        p->priority = new_priority;
+    }
+
+    update_runnable(p, tick);
+    return true;
+}
+
+static double percent(unsigned long long part, unsigned long long whole) {
+    return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+static int compare_ticks_run(const void *a, const void *b) {
+    const proc_stats *x = *(proc_stats *const *) a;
+    const proc_stats *y = *(proc_stats *const *) b;
+    return (y->ticks_run > x->ticks_run) - (y->ticks_run < x->ticks_run);
+}
+
+static void report_cpu_share() {
+    unsigned long long elapsed = last_tick - first_tick;
+    unsigned long long busy = 0;
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        busy += class_ticks[i];
+    }
+
+    printf("\nCPU share by priority class\n");
+    printf("  %-6s %10s %10s %7s\n", "class", "dispatches", "ticks", "share");
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        printf("  %-6s %10lu %10llu %6.1f%%\n", class_names[i], class_dispatches[i], class_ticks[i],
+               percent(class_ticks[i], elapsed));
+    }
+
+    printf("  %-6s %10s %10llu %6.1f%%\n", "idle", "", elapsed - MIN(busy, elapsed),
+           percent(elapsed - MIN(busy, elapsed), elapsed));
+
+    qsort(procs, num_procs, sizeof(proc_stats *), compare_ticks_run);
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        printf("\nTop %s priority processes by CPU time\n", class_names[i]);
+        printf("  %6s %10s %10s %7s  %s\n", "pid", "dispatches", "ticks", "share", "cmd");
+
+        int listed = 0;
+
+        for (size_t j = 0; j < num_procs && listed < top; j++) {
+            proc_stats *p = procs[j];
+
+            if (class_of(p->priority) != i || p->dispatches == 0) {
+                continue;
+            }
+
+            printf("  %6d %10lu %10llu %6.1f%%  %s\n", p->pid, p->dispatches, p->ticks_run,
+                   percent(p->ticks_run, elapsed), p->cmd);
+            listed++;
+        }
+    }
+}
+
+// Prints a histogram of the samples of each class, and their p50, p99 and max.
+static void report_samples(const char *title, samples s[NUM_CLASSES]) {
+    printf("\n%s (ticks)\n", title);
+    printf("  %-10s", "");
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        qsort(s[i].vals, s[i].count, sizeof(unsigned int), compare_uints);
+        printf(" %8s", class_names[i]);
+    }
+
+    printf("\n");
+
+    unsigned long counts[NUM_CLASSES][NUM_BUCKETS] = {{0}};
+    int last_bucket = 0;
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        for (size_t j = 0; j < s[i].count; j++) {
+            int bucket = bucket_of(s[i].vals[j]);
+            counts[i][bucket]++;
+            last_bucket = MAX(last_bucket, bucket);
+        }
+    }
+
+    for (int b = 0; b <= last_bucket; b++) {
+        char label[32];
+
+        if (b <= 1) {
+            snprintf(label, sizeof(label), "%d", b);
+        } else if (b == NUM_BUCKETS - 1) {
+            snprintf(label, sizeof(label), "%u+", 1u << (b - 1));
+        } else {
+            snprintf(label, sizeof(label), "%u-%u", 1u << (b - 1), (1u << b) - 1);
+        }
+
+        printf("  %-10s", label);
+
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            printf(" %8lu", counts[i][b]);
+        }
+
+        printf("\n");
+    }
+
+    const char *stats[3] = {"p50", "p99", "max"};
+    double quantiles[3] = {0.5, 0.99, 1};
+
+    for (int k = 0; k < 3; k++) {
+        printf("  %-10s", stats[k]);
+
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            if (s[i].count == 0) {
+                printf(" %8s", "-");
+            } else {
+                printf(" %8u", quantile(&s[i], quantiles[k]));
+            }
+        }
+
+        printf("\n");
+    }
+}
+
+static void report_starvation() {
+    // Processes still waiting when the log ends count too.
+    for (size_t i = 0; i < num_procs; i++) {
+        proc_stats *p = procs[i];
+
+        if (p->runnable && last_tick - p->runnable_since > starve_ticks) {
+            add_incident(p, last_tick, last_tick - p->runnable_since);
+        }
+    }
+
+    printf("\nStarvation (runnable for more than %u ticks): %d incidents\n", starve_ticks, num_incidents);
+
+    for (int i = 0; i < MIN(num_incidents, MAX_LISTED_INCIDENTS); i++) {
+        incident *inc = &incidents[i];
+        printf("  [%u] pid %d (%s, %s) waited %u ticks\n", inc->tick, inc->proc->pid, inc->proc->cmd,
+               class_names[class_of(inc->priority)], inc->wait);
+    }
+
+    if (num_incidents > MAX_LISTED_INCIDENTS) {
+        printf("  ... and %d more\n", num_incidents - MAX_LISTED_INCIDENTS);
+    }
+}
+
+static void report_ratio() {
+    unsigned long total = 0;
+    int total_weight = 0;
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        total += contended_dispatches[i];
+        total_weight += weights[i];
+    }
+
+    printf("\nDispatch ratio while all classes were runnable (%lu dispatches)\n", total);
+
+    if (total == 0) {
+        printf("  all three classes were never runnable at once, so it can't be checked\n");
+        return;
+    }
+
+    double max_diff = 0;
+
+    printf("  %-6s %9s %9s\n", "class", "observed", "expected");
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        double observed = percent(contended_dispatches[i], total);
+        double expected = percent(weights[i], total_weight);
+
+        printf("  %-6s %8.1f%% %8.1f%%\n", class_names[i], observed, expected);
+
+        double diff = observed > expected ? observed - expected : expected - observed;
+        max_diff = MAX(max_diff, diff);
+    }
+
+    printf("  %s %d:%d:%d (largest difference %.1f points)\n",
+           max_diff <= RATIO_TOLERANCE ? "matches" : "DOES NOT match", weights[0], weights[1], weights[2],
+           max_diff);
+}
+
+// Applies the command line option opt. Returns false if it's not a valid option.
+static bool parse_option(char *opt) {
+    char *end;
+
+    if (strncmp(opt, "--weights=", strlen("--weights=")) == 0) {
+        int w[NUM_CLASSES];
+
+        if (sscanf(opt + strlen("--weights="), "%d:%d:%d", &w[0], &w[1], &w[2]) != 3 || w[0] <= 0 || w[1] <= 0 ||
+            w[2] <= 0) {
+            return false;
+        }
+
+        memcpy(weights, w, sizeof(weights));
+        return true;
+    }
+
+    if (strncmp(opt, "--starve=", strlen("--starve=")) == 0) {
+        starve_ticks = strtoul(opt + strlen("--starve="), &end, 10);
+        return *end == '\0';
+    }
+
+    if (strncmp(opt, "--top=", strlen("--top=")) == 0) {
+        top = strtol(opt + strlen("--top="), &end, 10);
+        return *end == '\0' && top >= 0;
+    }
+
+    return false;
+}
+
+int main(int argc, char **argv) {
+    char *log_name = DEFAULT_LOG_NAME;
+    int num_args = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            HANDLE_INVALID_INPUT_RET_VAL(!parse_option(argv[i]), USAGE, EXIT_FAILURE);
+        } else {
+            HANDLE_INVALID_INPUT_RET_VAL(num_args == 1, USAGE, EXIT_FAILURE);
+            log_name = argv[i];
+            num_args++;
+        }
+    }
+
+    FILE *log = fopen(log_name, "r");
+    HANDLE_SYS_CALL(log == NULL, "Error opening log file.");
+
+    char line[LINE_SIZE];
+    unsigned long skipped = 0;
+
+    while (fgets(line, sizeof(line), log) != NULL) {
+        if (!replay(line)) {
+            skipped++;
+        }
+    }
+
+    fclose(log);
+    end_run(last_tick);
+
+    printf("Scheduler log %s: %lu events, ticks %u to %u\n", log_name, num_events, first_tick, last_tick);
+
+    if (skipped > 0) {
+        printf("Skipped %lu lines that aren't events\n", skipped);
+    }
+
+    report_cpu_share();
+    report_samples("Run queue wait", queue_waits);
+    report_samples("Wakeup to run latency", wake_latencies);
+    report_starvation();
+    report_ratio();
+
+    for (size_t i = 0; i < num_procs; i++) {
+        free(procs[i]->cmd);
+        free(procs[i]);
+    }
+
+    free(procs);
+
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        free(queue_waits[i].vals);
+        free(wake_latencies[i].vals);
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Definitions of benchmarks that can be run from the shell.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "process_user_funcs.h"
+#include "scheduler_user_funcs.h"
+#include "../kernel/stacks.h"
+#include "../kernel/threads.h"
+#include "../lib/errno.h"
+#include "../lib/signals.h"
+#include "../lib/tagged_alloc.h"
+
+// Number of busy processes spawned by sched_bench.
+#define SCHED_BENCH_PROCS 1000
+
+// Number of times sched_bench renices every busy process.
+#define SCHED_BENCH_ROUNDS 10
+
+// Number of round trips ctx_bench times in each round, and how many rounds it runs of each switch.
+#define CTX_BENCH_SWITCHES 100000
+#define CTX_BENCH_ROUNDS 10
+
+// Returns the number of microseconds elapsed between start and end.
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000 + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void spin(void) {
+    while (1);
+}
+
+void sched_bench(void) {
+    static pid_t pids[SCHED_BENCH_PROCS];
+    char *argv[] = {"spin", NULL};
+    struct timespec start, end;
+    int num_procs = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (; num_procs < SCHED_BENCH_PROCS; num_procs++) {
+        pids[num_procs] = p_spawn(spin, argv, STDIN_FILENO, STDOUT_FILENO, 1);
+
+        if (pids[num_procs] == -1) {
+            p_perror("sched_bench: p_spawn");
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    dprintf(STDERR_FILENO, "spawned %d busy processes in %ld us\n", num_procs, elapsed_us(&start, &end));
+
+    // The rounds can get preempted by the busy processes, so the fastest round is the one to go by.
+    long fastest_us = -1;
+
+    for (int round = 0; round < SCHED_BENCH_ROUNDS; round++) {
+        int priority = round % 2 == 0 ? 0 : 1;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < num_procs; i++) {
+            p_nice(priority, pids[i]);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        long round_us = elapsed_us(&start, &end);
+        if (fastest_us == -1 || round_us < fastest_us) {
+            fastest_us = round_us;
+        }
+    }
+
+    dprintf(STDERR_FILENO, "fastest of %d rounds of %d p_nice calls: %ld us\n", SCHED_BENCH_ROUNDS, num_procs,
+            fastest_us);
+
+    for (int i = 0; i < num_procs; i++) {
+        p_kill(pids[i], S_SIGTERM);
+    }
+
+    while (p_waitpid(-1, NULL, false) > 0);
+}
+
+// The two contexts ctx_bench switches between, and the switch it's timing.
+static ucontext_t caller_context;
+static ucontext_t *bouncer_context;
+static void (*bench_switch)(ucontext_t *, ucontext_t *);
+
+static void ucontext_switch(ucontext_t *from, ucontext_t *to) {
+    swapcontext(from, to);
+}
+
+// Switches straight back every time it's switched to.
+static void bounce(void) {
+    while (1) {
+        bench_switch(bouncer_context, &caller_context);
+    }
+}
+
+// Returns the fastest of CTX_BENCH_ROUNDS rounds of round trips to the bouncer with switch_func,
+// in nanoseconds per switch.
+static double time_switches(void (*switch_func)(ucontext_t *, ucontext_t *)) {
+    struct timespec start, end;
+    long fastest_us = -1;
+
+    bench_switch = switch_func;
+
+    for (int round = 0; round < CTX_BENCH_ROUNDS; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < CTX_BENCH_SWITCHES; i++) {
+            switch_func(&caller_context, bouncer_context);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        long round_us = elapsed_us(&start, &end);
+        if (fastest_us == -1 || round_us < fastest_us) {
+            fastest_us = round_us;
+        }
+    }
+
+    return fastest_us * 1000.0 / (2 * CTX_BENCH_SWITCHES);
+}
+
+void ctx_bench(void) {
+    bouncer_context = tagged_malloc(MEM_CONTEXTS, sizeof(ucontext_t));
+
+    if (bouncer_context == NULL || !make_context(bouncer_context, bounce, NULL, MIN_STACK_SIZE)) {
+        dprintf(STDERR_FILENO, "ctx_bench: no memory for the context\n");
+        tagged_free(bouncer_context);
+        return;
+    }
+
+    double ucontext_ns = time_switches(ucontext_switch);
+    dprintf(STDERR_FILENO, "swapcontext: %.1f ns per switch\n", ucontext_ns);
+
+    if (fast_switch_available()) {
+        double fast_ns = time_switches(fast_swap_context);
+        dprintf(STDERR_FILENO, "fast switch: %.1f ns per switch (%.1fx)\n", fast_ns, ucontext_ns / fast_ns);
+    } else {
+        dprintf(STDERR_FILENO, "fast switch: not available in this build\n");
+    }
+
+    free_context(bouncer_context);
+}
@@ -0,0 +1,11 @@
+// Declarations of benchmarks that can be run from the shell.
+
+#pragma once
+
+// Spawns SCHED_BENCH_PROCS busy processes and times rounds of p_nice calls
+// moving every one of them between scheduler queues.
+void sched_bench(void);
+
+// Times switching back and forth between two contexts, with swapcontext() and with the fast
+// switch the scheduler uses.
+void ctx_bench(void);
@@ -4,22 +4,23 @@
 
 #include "../fat/fat_util.h"
 #include "../fat/file_kernel_funcs.h"
+#include "../kernel/console.h"
+#include "../kernel/pipe.h"
+#include "../kernel/scheduler.h"
 #include "../lib/fd.h"
 #include "../lib/file_system.h"
 #include "../lib/linked_list.h"
+#include "../lib/macros.h"
 #include "../lib/signals.h"
+#include "../lib/tagged_alloc.h"
 #include "../user/process_user_funcs.h"
 #include "../lib/errno.h"
 
-linked_list OFT;
+open_file_table OFT;
 file_system *f_fs;
-int ind;
 
 int f_mount(char *fs_name) {
-    init_linked_list(&OFT);
-
-    // Preserving the 0 and 1 index for STDIN and STDOUT
-    ind = 3;
+    init_oft(&OFT);
 
     init_unmounted_fs();
     mount(fs_name);
@@ -33,7 +34,7 @@ int f_mount(char *fs_name) {
 }
 
 void f_unmount(char *fs_name) {
-    clear(&OFT, free_file_descriptor);
+    clear_oft(&OFT, free_file_descriptor);
     umount();
     f_fs = NULL;
 }
@@ -75,10 +76,105 @@ int find_d_pos(char *name) {
     return -1;
 }
 
+// Gives the process its own copy of its fd table if it is shared with another process.
+// Every fd in the copy gets an additional reference in the OFT.
+static void unshare_fds(pcb *proc) {
+    fd_table *table = unshare_fd_table(proc->fds);
+
+    if (table == proc->fds) {
+        return;
+    }
+
+    for (int i = 0; i < table->count; i++) {
+        oft_get(&OFT, table->fds[i])->ref_index++;
+    }
+
+    proc->fds = table;
+}
+
+// Returns true if any fd in table is the end of a pipe.
+static bool has_pipe_ends(fd_table *table) {
+    for (int i = 0; i < table->count; i++) {
+        if (oft_get(&OFT, table->fds[i])->pipe != NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns true if files opened in mode replace the contents of the file.
+static bool is_rewrite_mode(int mode) {
+    return mode == F_WRITE || mode == F_OVERWRITE;
+}
+
+// Drops the cached blocks of every fd open on the file with directory entry de.
+// Needed whenever blocks of the file are freed, since the cached ones might be among them.
+static void invalidate_block_caches(directory_entry *de) {
+    for (int i = oft_next(&OFT, -1); i != -1; i = oft_next(&OFT, i)) {
+        if (OFT.entries[i]->de == de) {
+            OFT.entries[i]->pos_block = EOF_IDX;
+        }
+    }
+}
+
+// Shrinks the file with directory entry de to len bytes.
+static int truncate_file(directory_entry *de, int len) {
+    if (k_truncate(de, len, f_fs) == -1) {
+        return -1;
+    }
+
+    invalidate_block_caches(de);
+    return 1;
+}
+
+// Drops one reference to the file in the OFT. Once nothing references it
+// anymore, it's removed from the OFT and the file is deleted if it was unlinked.
+static void release_oft_entry(file_descriptor *file) {
+    file->ref_index--;
+
+    if (file->ref_index > 0) {
+        return;
+    }
+
+    if (file->pipe != NULL) {
+        close_pipe_end(file->pipe, file->mode == F_WRITE);
+        oft_remove(&OFT, file->ind, free_file_descriptor);
+        return;
+    }
+
+    directory_entry *de = (directory_entry *) file->de;
+
+    // Everything past what was written through the fd is left over from the old contents.
+    if (file->mode == F_OVERWRITE && de->name[0] != (char) DELETED_BUT_IN_USE) {
+        truncate_file(de, file->w_end);
+    }
+
+    // If the file was not unlinked yet, then do not delete the file, but free it from the OFT.
+    if (!exists_other_fd_by_d_pos(&OFT, file->d_pos, file->ind)) {
+        // In this case, this is the last instance of the file, so we delete it if it starts with a '2'.
+        if (de->name[0] == (char) DELETED_BUT_IN_USE) {
+            // mark the filename with a 1
+            de->name[0] = (char) DELETED;
+            free_file_blocks(de);
+            write_dell();
+        }
+    }
+
+    oft_remove(&OFT, file->ind, free_file_descriptor);
+}
+
+// Returns how many more fds can be opened.
+static int free_fd_numbers() {
+    return MAX_OPEN_FDS - NUM_STD_FDS - OFT.size;
+}
+
 int f_open(const char *fname, int mode) {
+    SYSTEM_CALL();
+
     int ref = 0;
 
-    if (mode < F_WRITE || mode > F_APPEND) {
+    if (mode < F_WRITE || mode > F_OVERWRITE) {
         set_errno(INVALID_MODE);
         return -1;
     } else if (fname == NULL) {
@@ -87,24 +183,23 @@ int f_open(const char *fname, int mode) {
     } else if (!is_posix(fname)) {
         set_errno(INVALID_FILE_NAME_POSIX);
         return -1;
-    } else if (ind != 2) {
+    } else if (free_fd_numbers() < 1) {
+        set_errno(TOO_MANY_OPEN_FILES);
+        return -1;
+    } else {
         // Checking if the file is already open in write mode.
-        linked_list_elem *curr = OFT.head;
+        for (int i = oft_next(&OFT, -1); i != -1; i = oft_next(&OFT, i)) {
+            file_descriptor *f = OFT.entries[i];
 
-        while (curr != NULL) {
-            file_descriptor *f = curr->val;
-
-            if (f != NULL && f->de != NULL && strcmp(fname, f->de->name) == 0) {
+            if (f->de != NULL && strcmp(fname, f->de->name) == 0) {
                 ref++;
 
-                // only throw an error if the current mode is F_WRITE as well.
-                if (mode == F_WRITE && f->mode == F_WRITE) {
+                // only throw an error if the current mode is F_WRITE (or F_OVERWRITE) as well.
+                if (is_rewrite_mode(mode) && is_rewrite_mode(f->mode)) {
                     set_errno(ATTEMPTED_DOUBLE_WRITE);
                     return -1;
                 }
             }
-
-            curr = curr->next;
         }
     }
 
@@ -134,23 +229,16 @@ int f_open(const char *fname, int mode) {
             return -1;
         }
 
-        if ((mode == F_WRITE || mode == F_APPEND) && (d->perm & READ_WRITE) != READ_WRITE) {
+        if (mode != F_READ && (d->perm & READ_WRITE) != READ_WRITE) {
             set_errno(PERMISSION_DENIED);
             return -1;
         }
 
         // If opened as write, then clear the file, and then append.
+        // F_OVERWRITE keeps the blocks and truncates on close instead.
         if (mode == F_WRITE) {
-            int block = d->firstBlock;
-
-            while (block != EOF_IDX) {
-                int next_block = f_fs->fat_region[block];
-                f_fs->fat_region[block] = 0;
-                block = next_block;
-            }
-
-            d->firstBlock = EOF_IDX;
-            d->size = 0;
+            free_file_blocks(d);
+            invalidate_block_caches(d);
         }
 
         strcpy(d->name, name);
@@ -158,33 +246,25 @@ int f_open(const char *fname, int mode) {
     }
     write_dell();
 
-    file_descriptor *f = (file_descriptor *) malloc(sizeof(file_descriptor));
+    file_descriptor *f = (file_descriptor *) tagged_malloc(MEM_FDS, sizeof(file_descriptor));
     HANDLE_SYS_CALL(f == NULL, "Unable to allocate FD\n");
 
     f->de = d;
-    f->ind = ++ind;
+    f->pipe = NULL;
     f->ref_index = 1;
     f->mode = mode;
-    f->f_pos = -1;
+    f->f_pos = mode == F_APPEND ? d->size : 0;
+    f->pos_block = EOF_IDX;
+    f->pos_block_idx = 0;
+    f->w_end = 0;
     f->d_pos = find_d_pos(name);
 
-    push_back(&OFT, f);
-
-    // In the case that the filesize is non-zero, update the f->pos depending on the mode.
-    if (d->size != 0 && f->mode == F_READ) {
-        f_lseek(ind, 0, F_SEEK_SET);
-    } else if (d->size != 0 && f->mode == F_APPEND) {
-        f_lseek(ind, 0, F_SEEK_END);
-    }
+    int ind = oft_insert(&OFT, f);
 
     // Need to add the fd to the pcb of the active process.
     pcb *active_job = get_active_job();
-    for (int i = 0; i < 1024; i++) {
-        if (active_job->fd[i] == -1) {
-            active_job->fd[i] = ind;
-            break;
-        }
-    }
+    unshare_fds(active_job);
+    fd_table_add(active_job->fds, ind);
     return ind;
 }
 
@@ -202,7 +282,22 @@ int redirect(int fd) {
     return fd;
 }
 
-int f_read(int fd, int n, char *buf) {
+// Charges the calling process for the bytes it read and wrote, and for the FAT blocks allocated
+// since there were blocks_before of them.
+static void charge_io(int bytes_read, int bytes_written, unsigned long blocks_before) {
+    pcb *calling_proc = get_active_job();
+
+    if (calling_proc == NULL) {
+        return;
+    }
+
+    calling_proc->usage.bytes_read += MAX(bytes_read, 0);
+    calling_proc->usage.bytes_written += MAX(bytes_written, 0);
+    calling_proc->usage.blocks_allocated += k_blocks_allocated() - blocks_before;
+}
+
+// f_read() without the accounting.
+static int read_fd(int fd, int n, char *buf) {
     fd = redirect(fd);
 
     // Terminal control.
@@ -212,8 +307,28 @@ int f_read(int fd, int n, char *buf) {
         suspend();
     }
 
-    if (fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO) {
-        return read(fd, buf, n);
+    if (fd == STDIN_FILENO) {
+        return console_read(buf, n);
+    }
+
+    if (fd == STDOUT_FILENO || fd == STDERR_FILENO) {
+        // Waiting for input mustn't hold up the other cores.
+        int depth = leave_kernel();
+        int bytes_read = read(fd, buf, n);
+        return_to_kernel(depth);
+
+        return bytes_read;
+    }
+
+    file_descriptor *file = oft_get(&OFT, fd);
+
+    if (file != NULL && file->pipe != NULL) {
+        if (file->mode != F_READ) {
+            set_errno(PERMISSION_DENIED);
+            return -1;
+        }
+
+        return pipe_read(file->pipe, buf, n);
     }
 
     int temp = k_read(fd, n, buf, f_fs, &OFT);
@@ -224,13 +339,34 @@ int f_read(int fd, int n, char *buf) {
     return temp;
 }
 
-int f_write(int fd, const char *str, int n) {
+int f_read(int fd, int n, char *buf) {
+    SYSTEM_CALL();
+
+    int bytes_read = read_fd(fd, n, buf);
+    charge_io(bytes_read, 0, k_blocks_allocated());
+
+    return bytes_read;
+}
+
+// f_write() without the accounting.
+static int write_fd(int fd, const char *str, int n) {
     fd = redirect(fd);
 
     if (fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO) {
         return write(fd, str, n);
     }
 
+    file_descriptor *file = oft_get(&OFT, fd);
+
+    if (file != NULL && file->pipe != NULL) {
+        if (file->mode != F_WRITE) {
+            set_errno(PERMISSION_DENIED);
+            return -1;
+        }
+
+        return pipe_write(file->pipe, str, n);
+    }
+
     int temp = k_write(fd, n, (char *) str, f_fs, &OFT);
     if (temp == -1) {
         set_errno(NO_MORE_SPACE);
@@ -239,62 +375,222 @@ int f_write(int fd, const char *str, int n) {
     return temp;
 }
 
-int f_close(int fd) {
-    // Remove this from the OFT.
-    // Also remove the fd from the active_job (see f_open()).
-    linked_list_elem *elem = get_elem(&OFT, OFT_find_fd_by_fd_predicate, &fd);
+int f_write(int fd, const char *str, int n) {
+    SYSTEM_CALL();
 
-    if (elem == NULL) {
-        set_errno(CLOSE_UNOPEN_FILE);
+    unsigned long blocks_before = k_blocks_allocated();
+    int bytes_written = write_fd(fd, str, n);
+    charge_io(0, bytes_written, blocks_before);
+
+    return bytes_written;
+}
+
+bool f_is_console(int fd) {
+    SYSTEM_CALL();
+
+    fd = redirect(fd);
+    return fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO;
+}
+
+// Writes n bytes of buf, which is in the kernel, to out_fd, whose OFT entry is out (NULL for the
+// console).
+static int splice_write(int out_fd, file_descriptor *out, const char *buf, int n) {
+    if (out == NULL) {
+        return write(out_fd, buf, n);
+    }
+
+    if (out->pipe != NULL) {
+        return pipe_write(out->pipe, buf, n);
+    }
+
+    return k_write(out_fd, n, (char *) buf, f_fs, &OFT);
+}
+
+// Reads up to n bytes from in_fd, whose OFT entry is in (NULL for the console), into buf, which
+// is in the kernel.
+static int splice_read(int in_fd, file_descriptor *in, char *buf, int n) {
+    if (in == NULL) {
+        return console_read(buf, n);
+    }
+
+    return k_read(in_fd, n, buf, f_fs, &OFT);
+}
+
+// f_splice() without the accounting.
+static int splice_fds(int in_fd, int out_fd, int n) {
+    in_fd = redirect(in_fd);
+    out_fd = redirect(out_fd);
+
+    // The console is read through STDIN, and written through STDOUT or STDERR.
+    bool out_console = out_fd == STDOUT_FILENO || out_fd == STDERR_FILENO;
+    file_descriptor *in = in_fd == STDIN_FILENO ? NULL : oft_get(&OFT, in_fd);
+    file_descriptor *out = out_console ? NULL : oft_get(&OFT, out_fd);
+
+    if ((in == NULL && in_fd != STDIN_FILENO) || (out == NULL && !out_console)) {
+        set_errno(FILE_NOT_FOUND_OFT);
         return -1;
     }
 
-    file_descriptor *file = elem->val;
+    if ((in != NULL && in->pipe != NULL && in->mode != F_READ) ||
+        (out != NULL && out->pipe != NULL && out->mode != F_WRITE)) {
+        set_errno(PERMISSION_DENIED);
+        return -1;
+    }
 
-    // If the number of references to this fd is greater than 1, then decrement the number of references and reset the value in the fd array in the active job.
-    if (file->ref_index >= 1) {
-        file->ref_index--;
-        pcb *active_job = get_active_job();
+    // Nothing would ever read what the process waits to write.
+    if (in != NULL && out != NULL && in->pipe != NULL && in->pipe == out->pipe) {
+        set_errno(SAME_PIPE);
+        return -1;
+    }
 
-        for (int i = 0; i < 1024; i++) {
-            if (active_job->fd[i] == file->ind) {
-                active_job->fd[i] = -1;
-                break;
-            }
-        }
+    // Terminal control.
+    pcb *calling_proc = get_active_job();
+    if (calling_proc->is_bg && in_fd == STDIN_FILENO) {
+        p_kill(calling_proc->pid, S_SIGSTOP);
+        suspend();
     }
 
-    if (file->ref_index != 0) {
-        return 1;
+    if (n <= 0) {
+        return 0;
     }
 
-    directory_entry *de = (directory_entry *) file->de;
+    // Bytes read or written in place stay in the pipe, where another process could move them if
+    // this one slept before consuming or committing them. Files and the console's output never
+    // sleep, but another pipe and the console's input do.
+    if (in != NULL && out != NULL && in->pipe != NULL && out->pipe != NULL) {
+        return pipe_splice(in->pipe, out->pipe, n);
+    }
 
-    // If the file was not unlinked yet, then do not delete the file, but free it from the OFT.
-    if (!exists_other_fd_by_d_pos(&OFT, file->d_pos, file->ind)) {
-        // In this case, this is the last instance of the file, so we delete it if it starts with a '2'.
-        if (de->name[0] == (char) DELETED_BUT_IN_USE) {
-            // mark the filename with a 1
-            de->name[0] = (char) DELETED;
-            de->size = 0;
-            int next_block = de->firstBlock;
+    if (in != NULL && in->pipe != NULL) {
+        char *data;
+        int len = pipe_peek(in->pipe, &data);
 
-            while (next_block != EOF_IDX) {
-                int temp_block = f_fs->fat_region[next_block];
-                f_fs->fat_region[next_block] = 0;
-                next_block = temp_block;
-            }
+        if (len == 0) {
+            return 0;
+        }
 
-            de->firstBlock = EOF_IDX;
-            write_dell();
+        int bytes_written = splice_write(out_fd, out, data, MIN(len, n));
+
+        if (bytes_written > 0) {
+            pipe_consume(in->pipe, bytes_written);
+        }
+
+        return bytes_written;
+    }
+
+    if (in != NULL && out != NULL && out->pipe != NULL) {
+        char *space;
+        int room = pipe_reserve(out->pipe, &space);
+
+        if (room == -1) {
+            return -1;
+        }
+
+        int bytes_read = splice_read(in_fd, in, space, MIN(room, n));
+
+        if (bytes_read > 0) {
+            pipe_commit(out->pipe, bytes_read);
         }
+
+        return bytes_read;
+    }
+
+    // Neither end is read or written in place, so the bytes go through a buffer in the kernel.
+    char buf[SPLICE_BUFFER_SIZE];
+    int bytes_read = splice_read(in_fd, in, buf, MIN(n, SPLICE_BUFFER_SIZE));
+
+    if (bytes_read <= 0) {
+        return bytes_read;
+    }
+
+    return splice_write(out_fd, out, buf, bytes_read);
+}
+
+int f_splice(int in_fd, int out_fd, int n) {
+    SYSTEM_CALL();
+
+    unsigned long blocks_before = k_blocks_allocated();
+    int bytes_moved = splice_fds(in_fd, out_fd, n);
+    charge_io(bytes_moved, bytes_moved, blocks_before);
+
+    return bytes_moved;
+}
+
+int f_close(int fd) {
+    SYSTEM_CALL();
+
+    // Remove this from the OFT.
+    // Also remove the fd from the active_job (see f_open()).
+    file_descriptor *file = oft_get(&OFT, fd);
+
+    if (file == NULL) {
+        set_errno(CLOSE_UNOPEN_FILE);
+        return -1;
+    }
+
+    pcb *active_job = get_active_job();
+
+    if (fd_table_contains(active_job->fds, fd)) {
+        unshare_fds(active_job);
+        fd_table_remove(active_job->fds, fd);
+    } else if (active_job->fd[0] == fd) {
+        active_job->fd[0] = STDIN_FILENO;
+    } else if (active_job->fd[1] == fd) {
+        active_job->fd[1] = STDOUT_FILENO;
+    } else {
+        // The fd is open, but not by this process.
+        set_errno(CLOSE_UNOPEN_FILE);
+        return -1;
     }
 
-    remove_elem(&OFT, OFT_find_fd_by_fd_predicate, &fd, free_file_descriptor);
+    release_oft_entry(file);
     return 1;
 }
 
+// Adds an end of pipe p, opened in mode, to the OFT and to the active process's fd table.
+// Returns its fd.
+static int open_pipe_end(kernel_pipe *p, int mode) {
+    file_descriptor *f = (file_descriptor *) tagged_malloc(MEM_FDS, sizeof(file_descriptor));
+    HANDLE_SYS_CALL(f == NULL, "Unable to allocate FD\n");
+
+    f->de = NULL;
+    f->pipe = p;
+    f->ref_index = 1;
+    f->mode = mode;
+    f->f_pos = 0;
+    f->pos_block = EOF_IDX;
+    f->pos_block_idx = 0;
+    f->w_end = 0;
+    f->d_pos = -1;
+
+    int ind = oft_insert(&OFT, f);
+
+    pcb *active_job = get_active_job();
+    unshare_fds(active_job);
+    fd_table_add(active_job->fds, ind);
+    return ind;
+}
+
+int p_pipe(int fds[2]) {
+    SYSTEM_CALL();
+
+    // Both ends need an fd number.
+    if (free_fd_numbers() < 2) {
+        set_errno(TOO_MANY_OPEN_FILES);
+        return -1;
+    }
+
+    kernel_pipe *p = create_pipe();
+    HANDLE_SYS_CALL(p == NULL, "Unable to allocate a pipe\n");
+
+    fds[0] = open_pipe_end(p, F_READ);
+    fds[1] = open_pipe_end(p, F_WRITE);
+    return 0;
+}
+
 int f_unlink(const char *fname) {
+    SYSTEM_CALL();
+
     char *name = (char *) fname;
     linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, name);
 
@@ -309,21 +605,11 @@ int f_unlink(const char *fname) {
         return -1;
     }
 
-    linked_list_elem *elem_OFT = get_elem(&OFT, OFT_find_fd_by_name_predicate, name);
-    if (elem_OFT == NULL) {
+    if (oft_find_by_name(&OFT, name) == NULL) {
         // In this case, the file is not open. Therefore, we delete the file and free the FAT.
         // mark the filename with a 1.
         de->name[0] = (char) DELETED;
-        de->size = 0;
-        int next_block = de->firstBlock;
-
-        while (next_block != EOF_IDX) {
-            int temp_block = f_fs->fat_region[next_block];
-            f_fs->fat_region[next_block] = 0;
-            next_block = temp_block;
-        }
-
-        de->firstBlock = EOF_IDX;
+        free_file_blocks(de);
     } else {
         // In this case, the file is open. Therefore, we mark it as deleted but in use.
         // mark the filename with a 2.
@@ -335,6 +621,15 @@ int f_unlink(const char *fname) {
 }
 
 int f_lseek(int fd, int offset, int whence) {
+    SYSTEM_CALL();
+
+    file_descriptor *file = oft_get(&OFT, fd);
+
+    if (file != NULL && file->pipe != NULL) {
+        set_errno(NOT_A_FILE);
+        return -1;
+    }
+
     int temp = k_lseek(fd, offset, whence, f_fs, &OFT);
     if (temp == -1) {
         set_errno(NO_MORE_SPACE);
@@ -343,52 +638,131 @@ int f_lseek(int fd, int offset, int whence) {
     return temp;
 }
 
-int f_ls(char *filename) {
-    // Since the file wasn't found, print out all files.
-    // The columns above are first block number, permissions, size, month, day, time, and name.
-    char months[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+int f_truncate(const char *fname, int len) {
+    SYSTEM_CALL();
 
-    for (linked_list_elem *l = f_fs->dir.head; l != NULL; l = l->next) {
-        directory_entry *de = l->val;
+    linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, (char *) fname);
 
-        if (filename != NULL && strcmp(de->name, filename) != 0) {
-            continue;
-        }
+    if (elem == NULL) {
+        set_errno(FILE_NOT_FOUND);
+        return -1;
+    }
 
-        if (de->name[0] < FILE_EXISTS) {
-            continue;
-        }
+    directory_entry *de = (directory_entry *) elem->val;
+    if ((de->perm & WRITE_ONLY) == 0) {
+        set_errno(PERMISSION_DENIED);
+        return -1;
+    }
+
+    return truncate_file(de, len);
+}
+
+int f_ftruncate(int fd, int len) {
+    SYSTEM_CALL();
+
+    fd = redirect(fd);
+    file_descriptor *file = oft_get(&OFT, fd);
+
+    if (file == NULL) {
+        set_errno(FILE_NOT_FOUND);
+        return -1;
+    }
+
+    if (file->pipe != NULL) {
+        set_errno(NOT_A_FILE);
+        return -1;
+    }
 
-        int block_num = de->firstBlock;
-        char x = de->perm & EXEC_ONLY ? 'x' : '-';
-        char r = de->perm & READ_ONLY ? 'r' : '-';
-        char w = de->perm & WRITE_ONLY ? 'w' : '-';
-        int size = de->size;
-        char *name = de->name;
+    if (file->mode == F_READ) {
+        set_errno(PERMISSION_DENIED);
+        return -1;
+    }
+
+    return truncate_file(file->de, len);
+}
 
-        struct tm t = *localtime(&de->mtime);
+dir_stream *f_opendir() {
+    SYSTEM_CALL();
 
-        char *month = months[t.tm_mon];
-        int day = t.tm_mday;
-        int hour = t.tm_hour;
-        int minute = t.tm_min;
+    dir_stream *dir = (dir_stream *) tagged_malloc(MEM_STREAMS, sizeof(dir_stream));
+    HANDLE_SYS_CALL(dir == NULL, "Unable to allocate dir stream\n");
 
-        char str[MAX_LINE_LENGTH] = {'\0'}; // Way more than necessary.
-        sprintf(str, "%5d %c%c%c %5d %s %-2d %02d:%02d %s\n", block_num, x, r, w, size, month, day, hour, minute, name);
-        f_write(STDOUT_FILENO, str, strlen(str));
+    dir->next = f_fs->dir.head;
+    return dir;
+}
+
+int f_readdir_batch(dir_stream *dir, file_stat *stats, int max) {
+    SYSTEM_CALL();
+
+    if (dir == NULL) {
+        set_errno(FILE_NOT_FOUND);
+        return -1;
+    }
+
+    return read_dir_batch(&dir->next, stats, max);
+}
+
+void f_closedir(dir_stream *dir) {
+    SYSTEM_CALL();
+
+    tagged_free(dir);
+}
+
+int f_stat(const char *fname, file_stat *st) {
+    SYSTEM_CALL();
+
+    linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, (char *) fname);
+
+    if (elem == NULL) {
+        set_errno(FILE_NOT_FOUND);
+        return -1;
     }
 
+    stat_directory_entry((directory_entry *) elem->val, st);
+    return 1;
+}
+
+int f_ls(char *filename) {
+    SYSTEM_CALL();
+
+    file_stat stats[LS_PAGE_ENTRIES];
+    char page[LS_PAGE_ENTRIES * LS_LINE_LENGTH];
+
+    if (filename != NULL) {
+        if (f_stat(filename, &stats[0]) == -1) {
+            return 0;
+        }
+
+        f_write(STDOUT_FILENO, page, format_ls_page(page, stats, 1));
+        return 1;
+    }
+
+    // One write per page of files.
+    dir_stream *dir = f_opendir();
+    int n;
+
+    while ((n = f_readdir_batch(dir, stats, LS_PAGE_ENTRIES)) > 0) {
+        f_write(STDOUT_FILENO, page, format_ls_page(page, stats, n));
+    }
+
+    f_closedir(dir);
     return 1;
 }
 
 int f_rename(int fd, char *new_name) {
-    linked_list_elem *elem = get_elem(&OFT, OFT_find_fd_by_fd_predicate, &fd);
-    if (elem == NULL) {
+    SYSTEM_CALL();
+
+    file_descriptor *f = oft_get(&OFT, fd);
+    if (f == NULL) {
         set_errno(FILE_NOT_FOUND);
         return -1;
     }
 
-    file_descriptor *f = (file_descriptor *) elem->val;
+    if (f->pipe != NULL) {
+        set_errno(NOT_A_FILE);
+        return -1;
+    }
+
     strcpy(f->de->name, new_name);
     f->de->mtime = time(NULL);
     write_dell();
@@ -396,6 +770,8 @@ int f_rename(int fd, char *new_name) {
 }
 
 int f_change_perms(char *fname, char *op, int perm) {
+    SYSTEM_CALL();
+
     linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, fname);
     if (elem == NULL) {
         set_errno(FILE_NOT_FOUND);
@@ -414,12 +790,28 @@ int f_change_perms(char *fname, char *op, int perm) {
 }
 
 void f_update_new_child_fd(pcb *child) {
-    for (int i = 0; i < MAX_OPEN_FDS; i++) {
+    // A pipe only reaches its end once every write end is closed, so a child doesn't inherit the
+    // pipe ends its parent has open, only those it's given as fd0 or fd1.
+    if (has_pipe_ends(child->fds)) {
+        unshare_fds(child);
+
+        // Going backwards, since removing an fd moves the last one into its slot.
+        for (int i = child->fds->count - 1; i >= 0; i--) {
+            file_descriptor *f = oft_get(&OFT, child->fds->fds[i]);
+
+            if (f->pipe != NULL) {
+                fd_table_remove(child->fds, f->ind);
+                release_oft_entry(f);
+            }
+        }
+    }
+
+    // Files in the fd table are already referenced through the table shared with the parent.
+    for (int i = 0; i < 2; i++) {
         if (child->fd[i] > 2) {
-            linked_list_elem *elem = get_elem(&OFT, OFT_find_fd_by_fd_predicate, &child->fd[i]);
+            file_descriptor *f = oft_get(&OFT, child->fd[i]);
 
-            if (elem != NULL) {
-                file_descriptor *f = elem->val;
+            if (f != NULL) {
                 f->ref_index++;
             } else {
                 set_errno(FILE_NOT_FOUND_OFT);
@@ -430,22 +822,41 @@ void f_update_new_child_fd(pcb *child) {
 }
 
 void f_close_child_fd(pcb *child) {
-    for (int i = 0; i < MAX_OPEN_FDS; i++) {
+    if (child->fds != NULL) {
+        // Only the last process referencing the table closes the files in it.
+        if (child->fds->refs == 1) {
+            for (int i = 0; i < child->fds->count; i++) {
+                file_descriptor *f = oft_get(&OFT, child->fds->fds[i]);
+
+                if (f != NULL) {
+                    release_oft_entry(f);
+                }
+            }
+        }
+
+        release_fd_table(child->fds);
+        child->fds = NULL;
+    }
+
+    for (int i = 0; i < 2; i++) {
         if (child->fd[i] > 2) {
-            linked_list_elem *elem = get_elem(&OFT, OFT_find_fd_by_fd_predicate, &child->fd[i]);
+            file_descriptor *f = oft_get(&OFT, child->fd[i]);
 
-            if (elem != NULL) {
-                f_close(child->fd[i]);
+            if (f != NULL) {
+                release_oft_entry(f);
             } else {
                 set_errno(FILE_NOT_FOUND_OFT);
-                return;
             }
+
+            child->fd[i] = i == 0 ? STDIN_FILENO : STDOUT_FILENO;
         }
     }
 }
 
 // Returns -1 if file does not exist, otherwise returns size of the file.
 int f_size(char *file) {
+    SYSTEM_CALL();
+
     linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, file);
 
     if (elem == NULL) {
@@ -457,6 +868,8 @@ int f_size(char *file) {
 }
 
 bool f_has_permissions(char *file, int perm) {
+    SYSTEM_CALL();
+
     linked_list_elem *elem = get_elem(&f_fs->dir, ll_find_file_by_name_predicate, file);
 
     if (elem == NULL) {
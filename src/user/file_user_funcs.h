@@ -2,8 +2,16 @@
 
 #pragma once
 
+#include "../lib/directory_entry.h"
+#include "../lib/linked_list.h"
 #include "../lib/pcb.h"
 
+// A stream over the files in the directory, as returned by f_opendir().
+typedef struct dir_stream_st {
+    // The next directory entry to look at. NULL once the whole directory was read.
+    linked_list_elem *next;
+} dir_stream;
+
 // Mounts a file system with the specificed name.
 int f_mount(char *fs_name);
 
@@ -24,10 +32,29 @@ int f_read(int fd, int n, char *buf);
 // of bytes written, and return `-1` upon error.
 int f_write(int fd, const char *str, int n);
 
+// Most bytes f_splice() moves per call.
+#define SPLICE_BUFFER_SIZE 4096
+
+// Moves up to n bytes from in_fd to out_fd without copying them through a buffer of the caller.
+// Bytes leaving a pipe are written straight from the pipe's buffer, and bytes going into one are
+// read straight into it. Waits for input like f_read(). Returns the number of bytes moved, `0`
+// at end of file, or `-1` upon error.
+int f_splice(int in_fd, int out_fd, int n);
+
+// Returns true if the fd reads from or writes to the console, rather than a file or a pipe it
+// was redirected to.
+bool f_is_console(int fd);
+
 // Removes the fd from the OFT and returns `1` upon success, otherwise returns
 // `-1`.
 int f_close(int fd);
 
+// Creates a pipe and stores the fds of its read and write ends in fds[0] and fds[1]. Bytes
+// written to fds[1] are read from fds[0]: reading waits until there are some, and returns 0 once
+// every write end is closed, while writing waits while the pipe is full. A spawned process only
+// gets the pipe ends it's given as fd0 or fd1. Returns 0 upon success, and -1 upon error.
+int p_pipe(int fds[2]);
+
 // Yeets the file, as long as it is not in the OFT.
 int f_unlink(const char *fname);
 
@@ -39,6 +66,28 @@ int f_unlink(const char *fname);
 // Returns 1 upon success, and -1 in the case of an error.
 int f_lseek(int fd, int offset, int whence);
 
+// Shrinks the file fname to len bytes, freeing only the blocks past the new end.
+// Lengths past the end of the file leave it unchanged.
+// Returns 1 upon success, and -1 in the case of an error.
+int f_truncate(const char *fname, int len);
+
+// Same as f_truncate(), but for the file open as fd. The fd must be open for writing.
+int f_ftruncate(int fd, int len);
+
+// Opens a stream over the files in the directory. Must be closed with f_closedir().
+dir_stream *f_opendir();
+
+// Fills stats with the stats of the next (up to) max files in the directory stream.
+// Returns the number of stats filled, which is 0 once every file was read, and -1 upon error.
+int f_readdir_batch(dir_stream *dir, file_stat *stats, int max);
+
+// Closes a directory stream opened by f_opendir().
+void f_closedir(dir_stream *dir);
+
+// Fills st with the stats of the file fname, without opening it.
+// Returns 1 upon success, and -1 if the file does not exist.
+int f_stat(const char *fname, file_stat *st);
+
 // Lists the file filename in the directory.
 // Lists all the files in the current directory if filename is NULL.
 // This returns 1 if the filename is found, otherwise it returns 0.
@@ -52,12 +101,12 @@ int f_rename(int fd, char *new_name);
 // Returns 1 upon success, otherwise returns -1 upon error.
 int f_change_perms(char *fname, char *op, int perm);
 
-// Given a pcb, iterate through the fd and increment the
-// reference count for each of the fd's.
+// Given a newly spawned pcb, increment the reference count for its stdin and
+// stdout fd's. The rest of its fd's are shared with the parent's fd table.
 void f_update_new_child_fd(pcb *child);
 
-// Given a pcb, iterate through the fd and close each of
-// the fd's in the array.
+// Given a pcb, drop its reference to its fd table, closing each of the fd's in
+// it if no other process shares the table, and close its stdin and stdout fd's.
 void f_close_child_fd(pcb *child);
 
 // Returns -1 if file does not exist, otherwise returns size of the file.
@@ -3,12 +3,17 @@
 #include "process_user_funcs.h"
 
 #include "file_user_funcs.h"
+#include "stream_user_funcs.h"
 
 #include "../kernel/process_kernel_funcs.h"
 #include "../kernel/pcb_table.h"
 #include "../kernel/threads.h"
+#include "../kernel/scheduler.h"
+#include "../kernel/stacks.h"
+#include "../kernel/wait_queue.h"
 #include "../lib/log.h"
 #include "../lib/signals.h"
+#include "../lib/tagged_alloc.h"
 #include "../lib/errno.h"
 
 // Dynamically allocate command name.
@@ -22,7 +27,7 @@ char *allocate_process_name(char *argv[]) {
         total_str_len += strlen(argv[i]);
     }
 
-    char *cmd = (char *) malloc(total_str_len * sizeof(char));
+    char *cmd = (char *) tagged_malloc(MEM_ARGV, total_str_len * sizeof(char));
     if (cmd == NULL) {
         return NULL;
     }
@@ -50,7 +55,7 @@ char **allocate_arguments(char *argv[]) {
     int num_args = 0;
     for (; argv[num_args] != NULL; num_args++);
 
-    char **ret_val = (char **) malloc((num_args + 1) * sizeof(char *));
+    char **ret_val = (char **) tagged_malloc(MEM_ARGV, (num_args + 1) * sizeof(char *));
     if (ret_val == NULL) {
         return NULL;
     }
@@ -58,7 +63,7 @@ char **allocate_arguments(char *argv[]) {
     ret_val[num_args] = NULL;
 
     for (int i = 0; i < num_args; i++) {
-        ret_val[i] = (char *) malloc((strlen(argv[i]) + 1) * sizeof(char));
+        ret_val[i] = (char *) tagged_malloc(MEM_ARGV, (strlen(argv[i]) + 1) * sizeof(char));
         strcpy(ret_val[i], argv[i]);
     }
 
@@ -66,6 +71,12 @@ char **allocate_arguments(char *argv[]) {
 }
 
 pid_t p_spawn(void (*func)(), char *argv[], int fd0, int fd1, int priority) {
+    return p_spawn_with_stack(func, argv, fd0, fd1, priority, DEFAULT_STACK_SIZE);
+}
+
+pid_t p_spawn_with_stack(void (*func)(), char *argv[], int fd0, int fd1, int priority, size_t stack_size) {
+    SYSTEM_CALL();
+
     pcb *parent_job = get_active_job();
 
     if (parent_job == NULL) {
@@ -78,6 +89,11 @@ pid_t p_spawn(void (*func)(), char *argv[], int fd0, int fd1, int priority) {
         return -1;
     }
 
+    if (stack_size > MAX_STACK_SIZE) {
+        set_errno(INVALIDSTACKSIZE);
+        return -1;
+    }
+
     pcb *child_process = k_process_create(parent_job);
 
     if (child_process == NULL) {
@@ -94,20 +110,21 @@ pid_t p_spawn(void (*func)(), char *argv[], int fd0, int fd1, int priority) {
 
     child_process->argv = allocate_arguments(argv);
 
-    child_process->priority = priority;
+    if (!make_context(child_process->context, func, child_process->argv, stack_size)) {
+        extract_elem(parent_job->childLL, pid_equal_predicate, &child_process->pid);
+        free_process_pcb(child_process);
 
-    for (int i = 2; i < MAX_OPEN_FDS; i++) {
-        if (child_process->fd[i] == fd0 || child_process->fd[i] == fd1) {
-            child_process->fd[i] = EMPTY_FD;
-        }
+        set_errno(NOCHILDCREATED);
+        return -1;
     }
 
+    child_process->priority = priority;
+
     child_process->fd[0] = fd0;
     child_process->fd[1] = fd1;
 
     f_update_new_child_fd(child_process);
 
-    make_context(child_process->context, func, child_process->argv);
     add_job_to_scheduler(child_process);
     add_pcb_to_table(child_process);
 
@@ -118,6 +135,8 @@ pid_t p_spawn(void (*func)(), char *argv[], int fd0, int fd1, int priority) {
 }
 
 int p_kill(pid_t pid, int sig) {
+    SYSTEM_CALL();
+
     if (sig == INVALID) {
         set_errno(INVALIDSIGNAL);
         return -1;
@@ -126,7 +145,18 @@ int p_kill(pid_t pid, int sig) {
     pcb *target_job = find_pcb_in_table(pid);
 
     if (target_job != NULL) {
-        remove_job_from_scheduler(target_job);
+        // Like a zombie's, a terminated process's status doesn't change anymore. Killing one
+        // that exited again would add it to its parent's zombies twice.
+        if (target_job->status == TERMINATED || target_job->status == EXITED ||
+            target_job->status == ORPHANED) {
+            return 0;
+        }
+
+        // Continuing a process that isn't stopped leaves it in its queue.
+        if (sig != S_SIGCONT || target_job->status == STOPPED) {
+            remove_job_from_scheduler(target_job);
+        }
+
         k_process_kill(target_job, sig);
         return 0;
     } else {
@@ -135,154 +165,86 @@ int p_kill(pid_t pid, int sig) {
     }
 }
 
-pcb *find_changed_child(pcb *parent_pcb, pid_t child_pid) {
-    // Look through child queues to see if any child changed status.
-    linked_list *child_list = parent_pcb->childLL;
+// Reports the status change of child, which has been taken off its parent's changedLL, and
+// cleans it up if it's terminated. Returns its pid.
+static pid_t report_changed_child(pcb *child_pcb, int *wstatus, bool nohang) {
+    pid_t pid = child_pcb->pid;
 
-    // Iterate through the 2 child queues.
-    for (int i = 0; i < 2; i++) {
-        if (!is_empty(child_list)) {
-            linked_list_elem *cur_elem = child_list->head;
-
-            while (cur_elem != NULL) {
-                pcb *cur_pcb = cur_elem->val;
-
-                if (cur_pcb->status_changed) {
-                    return cur_pcb;
-                }
+    if (wstatus != NULL) {
+        *wstatus = (int) child_pcb->status;
+    }
 
-                cur_elem = cur_elem->next;
-            }
+    // Only want cleanup if process terminated.
+    if (child_pcb->status == TERMINATED || child_pcb->status == EXITED || child_pcb->status == ORPHANED) {
+        // Normal completion for background job (job status reporting)
+        if (nohang && child_pcb->status == EXITED && child_pcb->is_bg) {
+            fprintf(stderr, "Finished: %s\n", child_pcb->cmd);
         }
 
-        child_list = parent_pcb->zombieLL;
+        // Logging.
+        log_event(WAITED_EVT, child_pcb);
+        k_process_cleanup(child_pcb);
+    } else {
+        // Reset flag if status was changed but not terminated.
+        child_pcb->status_changed = 0;
     }
 
-    return NULL;
+    return pid;
 }
 
 pid_t p_waitpid(pid_t pid, int *wstatus, bool nohang) {
-    pcb *parent_pcb = get_active_job();
-    pcb *child_pcb = NULL;
+    SYSTEM_CALL();
 
-    bool wait_any_child = false;
-    if (pid == -1) {
-        wait_any_child = true;
-    }
+    pcb *parent_pcb = get_active_job();
 
-    if (wait_any_child) {
-        // If the child queues are empty, should return -1.
-        if (is_empty(parent_pcb->childLL) && is_empty(parent_pcb->zombieLL)) {
-            return -1;
-        }
+    if (pid != -1) {
+        // Look for the target child with given pid
+        linked_list_elem *child = get_elem(parent_pcb->zombieLL, pid_equal_predicate, &pid);
 
-        // Check if there's any child with a changed status.
-        child_pcb = find_changed_child(parent_pcb, pid);
-        if (child_pcb == NULL && nohang) {
-            // No child have changed status & no hang.
-            return 0;
+        if (child == NULL) {
+            child = get_elem(parent_pcb->childLL, pid_equal_predicate, &pid);
         }
-    } else {
-        // Look for the target child with given pid
-        linked_list_elem *child1 =
-                get_elem(parent_pcb->zombieLL, pid_equal_predicate, &pid);
-        linked_list_elem *child2 =
-                get_elem(parent_pcb->childLL, pid_equal_predicate, &pid);
 
         // Return -1 on error (no such child exists).
-        if (child1 == NULL && child2 == NULL) {
+        if (child == NULL) {
             // NOSUCHCHILD
             set_errno(NOSUCHCHILD);
             return -1;
         }
 
-        if (child1 != NULL) {
-            child_pcb = child1->val;
-        } else {
-            child_pcb = child2->val;
-        }
-    }
-
-    if (child_pcb != NULL) {
-        pid = child_pcb->pid;
+        // Callers polling a child go by its status even if it hasn't changed.
         if (wstatus != NULL) {
-            *wstatus = (int) child_pcb->status;
+            *wstatus = (int) ((pcb *) child->val)->status;
         }
     }
 
-    // Won't block.
-    if (nohang) {
-        if (child_pcb->status_changed) {
-            // Only want cleanup if process terminated.
-            if (child_pcb->status == TERMINATED ||
-                child_pcb->status == EXITED || child_pcb->status == ORPHANED) {
-                // Normal completion for background job (job status reporting)
-                if (child_pcb->status == EXITED && child_pcb->is_bg) {
-                    fprintf(stderr, "Finished: %s\n", child_pcb->cmd);
-                }
-
-                // Logging.
-                log_event(WAITED_EVT, child_pcb);
-
-                k_process_cleanup(child_pcb);
-            } else {
-                // Rest flag if status was changed but not terminated.
-                child_pcb->status_changed = 0;
-            }
-            return pid;
-        } else {
-            // No change in status.
-            return 0;
+    while (true) {
+        // If there's no child to wait for, should return -1.
+        if (pid == -1 && is_empty(parent_pcb->childLL) && is_empty(parent_pcb->zombieLL)) {
+            return -1;
         }
-    } else {
-        // Block current process until child changes state.
-        // Only block if there's no status change yet.
-        if (child_pcb != NULL) {
-            if (child_pcb->status_changed == false) {
-                // Don't need to remove job from scheduler b/c already removed when running.
-                parent_pcb->blocked = true;
 
-                // Logging.
-                log_event(BLOCKED_EVT, parent_pcb);
-            }
+        // Children post their status changes to changedLL, so there's nothing to search for.
+        pcb *child_pcb = pid == -1 ? pop_head(parent_pcb->changedLL)
+                                   : extract_elem(parent_pcb->changedLL, pid_equal_predicate, &pid);
+
+        if (child_pcb != NULL) {
+            return report_changed_child(child_pcb, wstatus, nohang);
         }
 
-        while (true) {
-            if (wait_any_child) {
-                // If no child to wait and still blocking, should return -1.
-                if (is_empty(parent_pcb->childLL) && is_empty(parent_pcb->zombieLL)) {
-                    return -1;
-                }
-                child_pcb = find_changed_child(parent_pcb, pid);
-            }
-
-            if (child_pcb != NULL) {
-                if (child_pcb->status_changed) {
-                    pid = child_pcb->pid;
-                    if (wstatus != NULL) {
-                        *wstatus = (int) child_pcb->status;
-                    }
-
-                    if (child_pcb->status == TERMINATED || child_pcb->status == EXITED ||
-                        child_pcb->status == ORPHANED) {
-
-                        // Logging.
-                        log_event(WAITED_EVT, child_pcb);
-                        k_process_cleanup(child_pcb);
-                    } else {
-                        child_pcb->status_changed = 0;
-                    }
-
-                    return pid;
-                }
-            }
-
-            suspend();
+        if (nohang) {
+            // No child have changed status & no hang.
+            return 0;
         }
+
+        // Block current process until child changes state.
+        wait_on(parent_pcb->child_wait);
     }
 }
 
 void p_exit(void) {
+    SYSTEM_CALL();
+
     pcb *active_job = get_active_job();
 
     if (active_job == NULL) {
@@ -290,6 +252,9 @@ void p_exit(void) {
         return;
     }
 
+    // Buffered output is written before the fds are closed.
+    flush_streams();
+
     active_job->status = EXITED;
 
     // Logging.
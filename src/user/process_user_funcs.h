@@ -3,11 +3,16 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/types.h>
 
 // Forks a new thread that retains most of the attributes of the parent thread.
 pid_t p_spawn(void (*func)(), char *argv[], int fd0, int fd1, int prior);
 
+// Like p_spawn, but the new thread's stack is at least stack_size bytes (see stacks.h for the limits)
+// instead of the default. Running past the end of it crashes PennOS with a message naming the thread.
+pid_t p_spawn_with_stack(void (*func)(), char *argv[], int fd0, int fd1, int prior, size_t stack_size);
+
 // Sets the calling thread as blocked (if nohang is false) until a child of the calling thread changes state.
 // p_waitpid returns the pid of the child which has changed state on success, or -1 on error.
 pid_t p_waitpid(pid_t pid, int *wstatus, bool nohang);
@@ -0,0 +1,262 @@
+// Definition of the report of the sampling profiler.
+
+// dladdr needs the GNU extensions.
+#define _GNU_SOURCE
+
+#include "profile.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../kernel/pcb_table.h"
+#include "../kernel/profiler.h"
+#include "../kernel/scheduler.h"
+#include "../lib/macros.h"
+#include "../lib/tagged_alloc.h"
+
+// Start of the executable's image and end of its code, from the linker.
+extern char __executable_start[];
+extern char etext[];
+
+// A function of the executable, at its address in memory.
+typedef struct symbol_st {
+    uintptr_t start;
+    uintptr_t end;
+    const char *name;
+} symbol;
+
+// A function samples hit, and how many.
+typedef struct function_hits_st {
+    const char *name;
+    const char *module;
+    int hits;
+} function_hits;
+
+// The executable's symbol table, sorted by address. The names point into image.
+typedef struct symbol_table_st {
+    symbol *symbols;
+    int count;
+    char *image;
+} symbol_table;
+
+static int compare_symbols(const void *a, const void *b) {
+    const symbol *x = a;
+    const symbol *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static int compare_hits(const void *a, const void *b) {
+    return ((const function_hits *) b)->hits - ((const function_hits *) a)->hits;
+}
+
+// Reads the functions of the running executable from its symbol table. Leaves table empty if it
+// can't be read, e.g. if the executable is stripped.
+static void load_symbols(symbol_table *table) {
+    table->symbols = NULL;
+    table->count = 0;
+    table->image = NULL;
+
+    int fd = open("/proc/self/exe", O_RDONLY);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1) {
+            close(fd);
+        }
+
+        return;
+    }
+
+    table->image = (char *) tagged_malloc(MEM_PROFILING, st.st_size);
+    HANDLE_SYS_CALL(table->image == NULL, "Unable to allocate the symbol table\n");
+
+    ssize_t total = 0;
+
+    while (total < st.st_size) {
+        ssize_t n = read(fd, table->image + total, st.st_size - total);
+
+        if (n <= 0) {
+            break;
+        }
+
+        total += n;
+    }
+
+    close(fd);
+
+    ElfW(Ehdr) *ehdr = (ElfW(Ehdr) *) table->image;
+
+    if (total < st.st_size || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) {
+        return;
+    }
+
+    // A position independent executable is loaded at an offset from the addresses it was linked at.
+    ElfW(Phdr) *phdrs = (ElfW(Phdr) *) (table->image + ehdr->e_phoff);
+    uintptr_t bias = (uintptr_t) __executable_start;
+
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD) {
+            bias -= phdrs[i].p_vaddr;
+            break;
+        }
+    }
+
+    ElfW(Shdr) *shdrs = (ElfW(Shdr) *) (table->image + ehdr->e_shoff);
+
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        if (shdrs[i].sh_type != SHT_SYMTAB) {
+            continue;
+        }
+
+        ElfW(Sym) *syms = (ElfW(Sym) *) (table->image + shdrs[i].sh_offset);
+        int num_syms = shdrs[i].sh_size / sizeof(ElfW(Sym));
+        char *strtab = table->image + shdrs[shdrs[i].sh_link].sh_offset;
+
+        table->symbols = (symbol *) tagged_malloc(MEM_PROFILING, num_syms * sizeof(symbol));
+        HANDLE_SYS_CALL(table->symbols == NULL, "Unable to allocate the symbol table\n");
+
+        for (int j = 0; j < num_syms; j++) {
+            if (ELF64_ST_TYPE(syms[j].st_info) == STT_FUNC && syms[j].st_value != 0) {
+                symbol *sym = &table->symbols[table->count++];
+                sym->start = syms[j].st_value + bias;
+                sym->end = sym->start + syms[j].st_size;
+                sym->name = strtab + syms[j].st_name;
+            }
+        }
+
+        qsort(table->symbols, table->count, sizeof(symbol), compare_symbols);
+        return;
+    }
+}
+
+// Returns the function of the executable holding pc, or NULL if there's none.
+static symbol *find_symbol(symbol_table *table, uintptr_t pc) {
+    // Shared libraries are mapped past the end of the executable's code.
+    if (pc < (uintptr_t) __executable_start || pc >= (uintptr_t) etext) {
+        return NULL;
+    }
+
+    int lo = 0;
+    int hi = table->count - 1;
+    symbol *found = NULL;
+
+    // The last function starting at or before pc.
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+
+        if (table->symbols[mid].start <= pc) {
+            found = &table->symbols[mid];
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return found != NULL && (found->end == found->start || pc < found->end) ? found : NULL;
+}
+
+// Returns the entry of the function called name in module, adding it if it's not in hits yet.
+static function_hits *find_hits(function_hits **hits, int *num_hits, const char *name, const char *module) {
+    for (int i = 0; i < *num_hits; i++) {
+        if ((*hits)[i].name == name && (*hits)[i].module == module) {
+            return &(*hits)[i];
+        }
+    }
+
+    *hits = (function_hits *) tagged_realloc(MEM_PROFILING, *hits, (*num_hits + 1) * sizeof(function_hits));
+    HANDLE_SYS_CALL(*hits == NULL, "Unable to allocate the profile\n");
+
+    function_hits *entry = &(*hits)[(*num_hits)++];
+    *entry = (function_hits) {.name = name, .module = module, .hits = 0};
+    return entry;
+}
+
+void print_profile(file_stream *out) {
+    SYSTEM_CALL();
+
+    profile_sample *samples = (profile_sample *) tagged_malloc(MEM_PROFILING, PROFILE_RING_SIZE * sizeof(profile_sample));
+    int *pid_hits = (int *) tagged_calloc(MEM_PROFILING, MAX_PID, sizeof(int));
+    HANDLE_SYS_CALL(samples == NULL || pid_hits == NULL, "Unable to allocate the profile\n");
+
+    long long dropped;
+    int count = get_profile_samples(samples, &dropped);
+
+    p_fprintf(out, "%d samples, one per tick of a running process", count);
+
+    if (dropped > 0) {
+        p_fprintf(out, " (%lld older ones were overwritten)", dropped);
+    }
+
+    p_fprintf(out, "\n");
+
+    if (count == 0) {
+        tagged_free(samples);
+        tagged_free(pid_hits);
+        return;
+    }
+
+    // Samples by process.
+    for (int i = 0; i < count; i++) {
+        if (samples[i].pid >= 0 && samples[i].pid < MAX_PID) {
+            pid_hits[samples[i].pid]++;
+        }
+    }
+
+    p_fprintf(out, "\n PID  SAMPLES      %%  CMD\n");
+
+    for (int pid = 0; pid < MAX_PID; pid++) {
+        if (pid_hits[pid] > 0) {
+            const char *name = profiled_process_name(pid);
+            p_fprintf(out, "%4d %8d %5.1f%%  %s\n", pid, pid_hits[pid], 100.0 * pid_hits[pid] / count,
+                      name != NULL ? name : "?");
+        }
+    }
+
+    // Samples by function.
+    symbol_table table;
+    load_symbols(&table);
+
+    function_hits *hits = NULL;
+    int num_hits = 0;
+
+    for (int i = 0; i < count; i++) {
+        symbol *sym = find_symbol(&table, (uintptr_t) samples[i].pc);
+        Dl_info info;
+
+        if (sym != NULL) {
+            find_hits(&hits, &num_hits, sym->name, NULL)->hits++;
+        } else if (samples[i].pc != NULL && dladdr(samples[i].pc, &info) != 0 && info.dli_sname != NULL) {
+            // dladdr's strings live as long as the library stays loaded.
+            const char *module = strrchr(info.dli_fname, '/');
+            find_hits(&hits, &num_hits, info.dli_sname, module != NULL ? module + 1 : info.dli_fname)->hits++;
+        } else {
+            find_hits(&hits, &num_hits, "??", NULL)->hits++;
+        }
+    }
+
+    qsort(hits, num_hits, sizeof(function_hits), compare_hits);
+
+    p_fprintf(out, "\n SAMPLES      %%  FUNCTION\n");
+
+    for (int i = 0; i < num_hits && i < PROFILE_TOP_FUNCTIONS; i++) {
+        p_fprintf(out, "%8d %5.1f%%  %s%s%s%s\n", hits[i].hits, 100.0 * hits[i].hits / count, hits[i].name,
+                  hits[i].module != NULL ? " (" : "", hits[i].module != NULL ? hits[i].module : "",
+                  hits[i].module != NULL ? ")" : "");
+    }
+
+    if (num_hits > PROFILE_TOP_FUNCTIONS) {
+        p_fprintf(out, "... and %d more functions\n", num_hits - PROFILE_TOP_FUNCTIONS);
+    }
+
+    tagged_free(hits);
+    tagged_free(table.symbols);
+    tagged_free(table.image);
+    tagged_free(samples);
+    tagged_free(pid_hits);
+}
@@ -0,0 +1,13 @@
+// Declaration of the report of the sampling profiler.
+
+#pragma once
+
+#include "stream_user_funcs.h"
+
+// Number of functions listed in a profile report.
+#define PROFILE_TOP_FUNCTIONS 20
+
+// Prints how many of the profiler's samples hit each process, and each function. Functions of
+// PennOS are looked up in its symbol table, which also has the static ones, and the others with
+// dladdr().
+void print_profile(file_stream *out);
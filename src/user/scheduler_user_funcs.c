@@ -3,13 +3,18 @@
 #include "scheduler_user_funcs.h"
 
 #include "../kernel/pcb_table.h"
+#include "../kernel/profiler.h"
+#include "../kernel/scheduler.h"
 
 #include "../lib/log.h"
+#include "../lib/macros.h"
 #include "../lib/pcb.h"
 #include "../lib/errno.h"
 
 // sets the priority of the thread pid to priority.
 int p_nice(int priority, pid_t pid) {
+    SYSTEM_CALL();
+
     if (!(priority == -1 || priority == 0 || priority == 1)) {
         set_errno(INVALIDPRIORITY);
         return -1;
@@ -24,26 +29,48 @@ int p_nice(int priority, pid_t pid) {
     }
 
     int old_nice = job->priority;
-    bool result = remove_job_from_scheduler(job);
-    if (!result) {
-        return -1;
-    }
-
     job->priority = (pid_t) priority;
 
-    add_job_to_scheduler(job);
+    // Move the job to its new queue if it's waiting to run. Otherwise it's
+    // queued by its new priority once it's runnable again.
+    if (remove_job_from_scheduler(job)) {
+        add_job_to_scheduler(job);
+    }
 
     // Logging.
     log_nice_event(job, old_nice);
     return 0;
 }
 
+int p_set_sched_weights(int high_weight, int mid_weight, int low_weight) {
+    SYSTEM_CALL();
+
+    if (!set_scheduler_weights(high_weight, mid_weight, low_weight)) {
+        set_errno(INVALIDWEIGHT);
+        return -1;
+    }
+
+    return 0;
+}
+
+void p_profile(bool enable) {
+    SYSTEM_CALL();
+
+    if (enable) {
+        start_profiler();
+    } else {
+        stop_profiler();
+    }
+}
+
 // Sets the calling process to blocked until ticks of the system clock elapse,
 // and then sets the thread to running. Importantly, p_sleep should not
 // return until the thread resumes running; however, it can be interrupted by a
 // S_SIGTERM signal. Like sleep(3) in Linux, the clock keeps ticking even when
 // p_sleep is interrupted.
 void p_sleep(unsigned int ticks) {
+    SYSTEM_CALL();
+
     pcb *calling_job = get_active_job();
 
     // ACTIVEJOBNULL
@@ -52,6 +79,9 @@ void p_sleep(unsigned int ticks) {
         return;
     }
 
+    // The clock may have stood still while this job had the CPU to itself.
+    sync_clock_ticks();
+
     calling_job->blocked = true;
 
     log_event(BLOCKED_EVT, calling_job);
@@ -59,3 +89,7 @@ void p_sleep(unsigned int ticks) {
 
     suspend();
 }
+
+void p_sleep_ms(unsigned int ms) {
+    p_sleep(MS_TO_TICKS(ms));
+}
@@ -2,14 +2,26 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <sys/types.h>
 
 // Sets the priority of the thread pid to priority.
 int p_nice(pid_t pid, int priority);
 
+// Sets the weights of the high, mid and low priority scheduler queues, i.e. the
+// ratio of dispatches between them while all of them have runnable jobs.
+// Returns 0 upon success, and -1 if any weight isn't positive.
+int p_set_sched_weights(int high_weight, int mid_weight, int low_weight);
+
+// Starts the sampling profiler, dropping the samples it took before, or stops it.
+void p_profile(bool enable);
+
 // Sets the calling process to blocked until ticks of the system clock elapse,
 // and then sets the thread to running. Importantly, p_sleep should not return
 // until the thread resumes running; however, it can be interrupted by a
 // S_SIGTERM signal. Like sleep(3) in Linux, the clock keeps ticking even when
 // p_sleep is interrupted.
-void p_sleep(unsigned int ticks);
\ No newline at end of file
+void p_sleep(unsigned int ticks);
+
+// Like p_sleep, but for ms milliseconds.
+void p_sleep_ms(unsigned int ms);
\ No newline at end of file
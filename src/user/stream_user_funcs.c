@@ -0,0 +1,282 @@
+// Function definitions for buffered streams.
+// A stream is only used by the process that opened it, so its buffer is filled and drained in
+// user level, and only a full buffer (or a complete line on the console) costs a system call.
+
+#include "stream_user_funcs.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_user_funcs.h"
+#include "../kernel/scheduler.h"
+#include "../lib/fd.h"
+#include "../lib/macros.h"
+#include "../lib/tagged_alloc.h"
+
+// Creates a stream over fd for the calling process.
+static file_stream *create_stream(int fd, int mode, bool owns_fd) {
+    pcb *proc = get_active_job();
+
+    if (proc == NULL) {
+        set_errno(ACTIVEJOBNULL);
+        return NULL;
+    }
+
+    file_stream *stream = (file_stream *) tagged_malloc(MEM_STREAMS, sizeof(file_stream));
+    HANDLE_SYS_CALL(stream == NULL, "Unable to allocate stream\n");
+
+    stream->fd = fd;
+    stream->mode = mode;
+    stream->line_buffered = mode != F_READ && f_is_console(fd);
+    stream->owns_fd = owns_fd;
+    stream->len = 0;
+    stream->pos = 0;
+    stream->eof = false;
+
+    stream->next = proc->streams;
+    proc->streams = stream;
+
+    return stream;
+}
+
+file_stream *p_fopen(const char *fname, int mode) {
+    int fd = f_open(fname, mode);
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    file_stream *stream = create_stream(fd, mode, true);
+
+    if (stream == NULL) {
+        f_close(fd);
+    }
+
+    return stream;
+}
+
+file_stream *p_fdopen(int fd, int mode) {
+    return create_stream(fd, mode, false);
+}
+
+// Returns the calling process's stream over the standard fd, creating it if there's none yet.
+static file_stream *std_stream(int fd, int mode) {
+    pcb *proc = get_active_job();
+
+    if (proc == NULL) {
+        set_errno(ACTIVEJOBNULL);
+        return NULL;
+    }
+
+    for (file_stream *stream = proc->streams; stream != NULL; stream = stream->next) {
+        if (stream->fd == fd && !stream->owns_fd) {
+            return stream;
+        }
+    }
+
+    return p_fdopen(fd, mode);
+}
+
+file_stream *p_stdin() {
+    return std_stream(STDIN_FILENO, F_READ);
+}
+
+file_stream *p_stdout() {
+    return std_stream(STDOUT_FILENO, F_WRITE);
+}
+
+int p_fflush(file_stream *stream) {
+    if (stream->mode == F_READ) {
+        return 0;
+    }
+
+    int written = 0;
+
+    while (written < stream->len) {
+        int n = f_write(stream->fd, stream->buf + written, stream->len - written);
+
+        if (n <= 0) {
+            stream->len = 0;
+            return -1;
+        }
+
+        written += n;
+    }
+
+    stream->len = 0;
+    return 0;
+}
+
+int p_fwrite(file_stream *stream, const char *buf, int n) {
+    if (stream->mode == F_READ) {
+        set_errno(PERMISSION_DENIED);
+        return -1;
+    }
+
+    // What doesn't fit in an empty buffer is written right away.
+    if (stream->len == 0 && n >= STREAM_BUFFER_SIZE) {
+        return f_write(stream->fd, buf, n);
+    }
+
+    int added = 0;
+
+    while (added < n) {
+        if (stream->len == STREAM_BUFFER_SIZE && p_fflush(stream) == -1) {
+            return -1;
+        }
+
+        int len = MIN(n - added, STREAM_BUFFER_SIZE - stream->len);
+        memcpy(stream->buf + stream->len, buf + added, len);
+
+        stream->len += len;
+        added += len;
+    }
+
+    if (stream->line_buffered && memchr(buf, '\n', n) != NULL && p_fflush(stream) == -1) {
+        return -1;
+    }
+
+    return n;
+}
+
+int p_fprintf(file_stream *stream, const char *format, ...) {
+    if (stream->mode == F_READ) {
+        set_errno(PERMISSION_DENIED);
+        return -1;
+    }
+
+    va_list args;
+
+    // Formatted straight into the buffer if it fits there.
+    va_start(args, format);
+    int room = STREAM_BUFFER_SIZE - stream->len;
+    int len = vsnprintf(stream->buf + stream->len, room, format, args);
+    va_end(args);
+
+    if (len < 0) {
+        return -1;
+    }
+
+    if (len < room) {
+        stream->len += len;
+
+        if (stream->line_buffered && memchr(stream->buf + stream->len - len, '\n', len) != NULL &&
+            p_fflush(stream) == -1) {
+            return -1;
+        }
+
+        return len;
+    }
+
+    char *str = (char *) tagged_malloc(MEM_STREAMS, len + 1);
+    HANDLE_SYS_CALL(str == NULL, "Unable to allocate formatted string\n");
+
+    va_start(args, format);
+    vsnprintf(str, len + 1, format, args);
+    va_end(args);
+
+    int result = p_fwrite(stream, str, len);
+    tagged_free(str);
+
+    return result;
+}
+
+char *p_fgets(char *buf, int size, file_stream *stream) {
+    if (stream->mode != F_READ) {
+        set_errno(PERMISSION_DENIED);
+        return NULL;
+    }
+
+    int n = 0;
+
+    while (n < size - 1) {
+        if (stream->pos == stream->len) {
+            if (stream->eof) {
+                break;
+            }
+
+            int bytes_read = f_read(stream->fd, STREAM_BUFFER_SIZE, stream->buf);
+
+            if (bytes_read == -1) {
+                return NULL;
+            }
+
+            stream->pos = 0;
+            stream->len = bytes_read;
+
+            // The console reports the end of the input once, so it isn't read again.
+            if (bytes_read == 0) {
+                stream->eof = true;
+                break;
+            }
+        }
+
+        // Copy up to the end of the line, of buf, or of what's buffered.
+        int len = MIN(size - 1 - n, stream->len - stream->pos);
+        char *newline = memchr(stream->buf + stream->pos, '\n', len);
+
+        if (newline != NULL) {
+            len = newline - (stream->buf + stream->pos) + 1;
+        }
+
+        memcpy(buf + n, stream->buf + stream->pos, len);
+        stream->pos += len;
+        n += len;
+
+        if (newline != NULL) {
+            break;
+        }
+    }
+
+    if (n == 0) {
+        return NULL;
+    }
+
+    buf[n] = '\0';
+    return buf;
+}
+
+int p_fclose(file_stream *stream) {
+    int result = p_fflush(stream);
+
+    if (stream->owns_fd && f_close(stream->fd) == -1) {
+        result = -1;
+    }
+
+    // Unlink it from the calling process's streams.
+    pcb *proc = get_active_job();
+    file_stream **link = &proc->streams;
+
+    while (*link != NULL && *link != stream) {
+        link = &(*link)->next;
+    }
+
+    if (*link != NULL) {
+        *link = stream->next;
+    }
+
+    tagged_free(stream);
+    return result;
+}
+
+void flush_streams() {
+    pcb *proc = get_active_job();
+
+    if (proc == NULL) {
+        return;
+    }
+
+    for (file_stream *stream = proc->streams; stream != NULL; stream = stream->next) {
+        p_fflush(stream);
+    }
+}
+
+void free_streams(pcb *proc) {
+    while (proc->streams != NULL) {
+        file_stream *next = proc->streams->next;
+        tagged_free(proc->streams);
+        proc->streams = next;
+    }
+}
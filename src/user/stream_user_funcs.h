@@ -0,0 +1,76 @@
+// Function declarations for buffered streams, which batch small reads and writes of a process
+// into few system calls.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "../lib/pcb.h"
+
+// Number of bytes a stream buffers.
+#define STREAM_BUFFER_SIZE 4096
+
+typedef struct file_stream_st {
+    // The fd the stream reads from or writes to.
+    int fd;
+
+    // The mode the fd was opened in. Streams opened in F_READ read, the others write.
+    int mode;
+
+    // Whether the stream writes each line as soon as it's complete, rather than once its
+    // buffer is full. True for streams writing to the console.
+    bool line_buffered;
+
+    // Whether the fd is closed along with the stream.
+    bool owns_fd;
+
+    // Bytes written but not flushed yet, or read from the fd but not returned yet. The unread
+    // bytes of a reading stream start at index pos.
+    char buf[STREAM_BUFFER_SIZE];
+    int len;
+    int pos;
+
+    // Whether a read reached the end of the input.
+    bool eof;
+
+    // Next stream opened by the same process.
+    struct file_stream_st *next;
+} file_stream;
+
+// Opens the file like f_open(), and returns a stream over it. Returns NULL upon error.
+file_stream *p_fopen(const char *fname, int mode);
+
+// Returns a stream over the fd, which was opened in mode. The fd isn't closed by p_fclose().
+// Returns NULL upon error.
+file_stream *p_fdopen(int fd, int mode);
+
+// Returns the calling process's stream over its stdin, or stdout, creating it on first use.
+file_stream *p_stdin();
+file_stream *p_stdout();
+
+// Adds the n bytes of buf to the stream, writing its buffer once it's full, or once a line is
+// complete if it's line buffered. Returns n, or `-1` upon error.
+int p_fwrite(file_stream *stream, const char *buf, int n);
+
+// Adds the output of printf(format, ...) to the stream, like p_fwrite(). Returns the number of
+// bytes added, or `-1` upon error.
+int p_fprintf(file_stream *stream, const char *format, ...);
+
+// Reads the next line of the stream, including its newline, into buf. A line longer than
+// size - 1 bytes is returned in pieces. buf is null terminated. Returns buf, or NULL at end of
+// file or upon error.
+char *p_fgets(char *buf, int size, file_stream *stream);
+
+// Writes the bytes buffered in the stream. They're dropped if that fails. Returns `0` upon
+// success, and `-1` upon error.
+int p_fflush(file_stream *stream);
+
+// Flushes the stream and frees it, closing its fd if it was opened by p_fopen(). Returns `0`
+// upon success, and `-1` upon error.
+int p_fclose(file_stream *stream);
+
+// Flushes every stream of the calling process. Called by p_exit().
+void flush_streams();
+
+// Frees the streams of proc without flushing them. Called once the process is freed.
+void free_streams(pcb *proc);